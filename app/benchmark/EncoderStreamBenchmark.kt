@@ -0,0 +1,121 @@
+/**
+ * JVM microbenchmark: EncoderStreamParser against the previous line path
+ * (StringBuilder, toString().trim(), JSONObject per line).
+ *
+ * Not part of the app build. Run from the repository root with a JDK,
+ * kotlinc and an org.json jar (the same API Android ships):
+ *
+ *   kotlinc app/src/main/java/com/cncpendant/app/EncoderStreamParser.kt \
+ *       app/benchmark/EncoderStreamBenchmark.kt -cp json.jar -include-runtime -d /tmp/stream-bench.jar
+ *   java -cp /tmp/stream-bench.jar:json.jar EncoderStreamBenchmarkKt
+ *
+ * Feeds a recorded-style session (encoder at 20 Hz, heartbeats, button
+ * snapshots and presses) in 64-byte USB packets and prints ns/line and
+ * heap bytes allocated per line for each path.
+ */
+
+import com.cncpendant.app.EncoderStreamParser
+import org.json.JSONObject
+import java.lang.management.ManagementFactory
+
+private var sink = 0L
+
+private fun sessionStream(lines: Int): ByteArray {
+    val sb = StringBuilder()
+    var position = 0L
+    var seq = 0L
+    for (i in 0 until lines) {
+        when {
+            i % 20 == 19 -> sb.append("{\"type\":\"heartbeat\",\"seq\":$seq,\"position\":$position,\"pinA\":1,\"pinB\":0}")
+            i % 20 == 9 -> sb.append("{\"type\":\"button_state\",\"seq\":${++seq},\"mask\":${1 shl (i % 28)},\"changed\":${1 shl (i % 28)},\"t\":${i * 50000L}}")
+            i % 40 == 4 -> sb.append("{\"type\":\"button\",\"seq\":${++seq},\"pin\":${i % 28},\"state\":\"pressed\"}")
+            else -> {
+                val delta = (i % 7) - 3
+                position += delta
+                sb.append("{\"type\":\"encoder\",\"seq\":${++seq},\"delta\":$delta,\"position\":${Math.floorMod(position, 100L)},\"count\":$position,\"velocity\":${delta * 12.5},\"t\":${i * 50000L},\"tx\":${i * 50000L + 120}}")
+            }
+        }
+        sb.append("\r\n")
+    }
+    return sb.toString().toByteArray(Charsets.US_ASCII)
+}
+
+// The previous UsbEncoderManager.onNewData/processMessage line handling
+private class LegacyLineParser {
+    private val readBuffer = StringBuilder()
+
+    fun onNewData(data: ByteArray, offset: Int, count: Int) {
+        for (i in offset until offset + count) {
+            val b = data[i]
+            if (b == '\n'.code.toByte()) {
+                val line = readBuffer.toString().trim()
+                readBuffer.setLength(0)
+                if (line.isNotEmpty()) processMessage(line)
+            } else {
+                readBuffer.append((b.toInt() and 0xFF).toChar())
+            }
+        }
+    }
+
+    private fun processMessage(line: String) {
+        val json = JSONObject(line)
+        sink += json.optLong("seq", -1)
+        when (json.optString("type", "")) {
+            "encoder" -> {
+                sink += json.optInt("delta", 0) + json.optLong("position", 0)
+                sink += json.optDouble("velocity", Double.NaN).toFloat().toLong()
+            }
+            "button" -> sink += json.optInt("pin", -1) + json.optString("state", "").length
+            "button_state" -> sink += json.optLong("mask", 0) + json.optLong("changed", 0) + json.optLong("t", 0)
+            "heartbeat" -> {}
+        }
+    }
+}
+
+private fun allocatedBytes(): Long {
+    val bean = ManagementFactory.getThreadMXBean() as com.sun.management.ThreadMXBean
+    return bean.getThreadAllocatedBytes(Thread.currentThread().id)
+}
+
+private fun measure(name: String, stream: ByteArray, lines: Int, feed: (ByteArray, Int, Int) -> Unit) {
+    val packet = 64
+    fun run() {
+        var offset = 0
+        while (offset < stream.size) {
+            val n = minOf(packet, stream.size - offset)
+            feed(stream, offset, n)
+            offset += n
+        }
+    }
+    repeat(20) { run() }    // JIT warm-up
+
+    val rounds = 50
+    val bytesBefore = allocatedBytes()
+    val start = System.nanoTime()
+    repeat(rounds) { run() }
+    val ns = System.nanoTime() - start
+    val bytes = allocatedBytes() - bytesBefore
+
+    val total = rounds.toDouble() * lines
+    println(String.format("%-28s %10.1f ns/line %10.1f B/line", name, ns / total, bytes / total))
+}
+
+fun main() {
+    val lines = 10000
+    val stream = sessionStream(lines)
+
+    val parser = EncoderStreamParser(object : EncoderStreamParser.Sink {
+        override fun onEvent(event: EncoderStreamParser.Event) {
+            sink += event.kind + event.seq + event.delta + event.position + event.mask + event.micros
+        }
+        override fun onOtherLine(line: ByteArray, length: Int) {
+            sink += JSONObject(String(line, 0, length, Charsets.ISO_8859_1)).length()
+        }
+    })
+    measure("stream.byte_parser", stream, lines) { data, offset, n -> parser.accept(data, offset, n) }
+
+    val legacy = LegacyLineParser()
+    measure("stream.legacy_json", stream, lines) { data, offset, n -> legacy.onNewData(data, offset, n) }
+
+    println("fast lines ${parser.fastLines}, other lines ${parser.otherLines} (sink $sink)")
+}
@@ -76,4 +76,7 @@ dependencies {
     
     // ONNX Runtime for on-device ML (Whisper + DeepFilterNet)
     implementation("com.microsoft.onnxruntime:onnxruntime-android:1.16.3")
+    
+    // JVM unit tests (app/src/test)
+    testImplementation("junit:junit:4.13.2")
 }
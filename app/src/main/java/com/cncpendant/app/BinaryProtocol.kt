@@ -0,0 +1,86 @@
+package com.cncpendant.app
+
+/**
+ * Binary message format of the RP2040 encoder firmware
+ * (mirror of rp2040-encoder/src/binary_protocol.h).
+ *
+ * Each message is COBS(record + crc16) followed by a 0x00 delimiter.
+ * A record is a type byte followed by a fixed little-endian payload;
+ * the CRC is CRC-16/CCITT-FALSE over the record, little-endian.
+ * Event records end in their uint32 sequence number; the heartbeat
+ * carries the last one the firmware wrote.
+ */
+object BinaryProtocol {
+    const val VERSION = 5
+
+    const val REC_ENCODER = 0x01     // int16 delta, int32 position, int16 velocity (0.1 counts/s), int64 count, uint32 t, uint32 tx, uint32 seq
+    const val REC_BUTTON = 0x02      // uint8 pin, uint8 pressed, uint32 seq
+    const val REC_HEARTBEAT = 0x03   // int32 position, uint8 pins, int64 count, uint32 seq
+    const val REC_PONG = 0x04        // int32 position, int64 count, uint32 t
+    const val REC_BUTTON_STATE = 0x05 // uint32 mask, uint32 changed, uint32 micros, uint32 seq
+    const val REC_CHORD = 0x06       // uint8 chord id, uint8 pressed, uint32 micros, uint32 seq
+    const val REC_TEXT = 0x7F        // JSON reply text
+
+    const val REC_ENCODER_SIZE = 29
+    const val REC_BUTTON_SIZE = 7
+    const val REC_HEARTBEAT_SIZE = 18
+    const val REC_PONG_SIZE = 17
+    const val REC_BUTTON_STATE_SIZE = 17
+    const val REC_CHORD_SIZE = 11
+
+    const val MAX_RECORD_SIZE = 512
+
+    // Largest COBS frame (without delimiter) for a record plus CRC
+    const val MAX_FRAME_SIZE = MAX_RECORD_SIZE + 2 + (MAX_RECORD_SIZE + 2) / 254 + 1
+
+    /** CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF) */
+    fun crc16(data: ByteArray, offset: Int, length: Int): Int {
+        var crc = 0xFFFF
+        for (i in offset until offset + length) {
+            crc = crc xor ((data[i].toInt() and 0xFF) shl 8)
+            repeat(8) {
+                crc = if ((crc and 0x8000) != 0) (crc shl 1) xor 0x1021 else crc shl 1
+            }
+            crc = crc and 0xFFFF
+        }
+        return crc
+    }
+
+    /**
+     * Decode one COBS frame (delimiter already stripped) into dst.
+     * @return decoded length, or -1 if the frame is malformed
+     */
+    fun cobsDecode(src: ByteArray, length: Int, dst: ByteArray): Int {
+        var inIdx = 0
+        var outIdx = 0
+        while (inIdx < length) {
+            val code = src[inIdx++].toInt() and 0xFF
+            if (code == 0 || inIdx + code - 1 > length || outIdx + code > dst.size) return -1
+            for (i in 1 until code) {
+                dst[outIdx++] = src[inIdx++]
+            }
+            if (code != 0xFF && inIdx < length) dst[outIdx++] = 0
+        }
+        return outIdx
+    }
+
+    /**
+     * Check the trailing CRC of a decoded frame.
+     * @return record length without the CRC, or -1 if the CRC does not match
+     */
+    fun checkRecord(frame: ByteArray, length: Int): Int {
+        if (length < 3) return -1
+        val recordLength = length - 2
+        val expected = le16(frame, recordLength)
+        return if (crc16(frame, 0, recordLength) == expected) recordLength else -1
+    }
+
+    fun le16(buf: ByteArray, offset: Int): Int =
+        (buf[offset].toInt() and 0xFF) or ((buf[offset + 1].toInt() and 0xFF) shl 8)
+
+    fun le32(buf: ByteArray, offset: Int): Int =
+        le16(buf, offset) or (le16(buf, offset + 2) shl 16)
+
+    fun le64(buf: ByteArray, offset: Int): Long =
+        (le32(buf, offset).toLong() and 0xFFFFFFFFL) or (le32(buf, offset + 4).toLong() shl 32)
+}
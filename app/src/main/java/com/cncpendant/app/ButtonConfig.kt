@@ -213,6 +213,11 @@ object ButtonConfigManager {
     private const val KEY_BUTTON_CONFIG = "button_config"
     private const val KEY_BOARD_TYPE = "board_type"
     
+    // GPIO bits of the FN modifier buttons, refreshed whenever the configs
+    // are loaded or saved; null until the first load
+    @Volatile
+    private var fnPinMask: Int? = null
+    
     fun saveBoardType(context: Context, boardType: BoardType) {
         context.getSharedPreferences(PREFS_NAME, Context.MODE_PRIVATE)
             .edit()
@@ -275,13 +280,18 @@ object ButtonConfigManager {
             .edit()
             .putString(KEY_BUTTON_CONFIG, jsonArray.toString())
             .apply()
+        fnPinMask = fnMaskOf(configs)
     }
     
     fun loadButtonConfigs(context: Context): List<ButtonConfig> {
         val json = context.getSharedPreferences(PREFS_NAME, Context.MODE_PRIVATE)
-            .getString(KEY_BUTTON_CONFIG, null) ?: return emptyList()
+            .getString(KEY_BUTTON_CONFIG, null)
+        if (json == null) {
+            fnPinMask = 0
+            return emptyList()
+        }
         
-        return try {
+        val configs = try {
             val jsonArray = JSONArray(json)
             (0 until jsonArray.length()).map { 
                 ButtonConfig.fromJson(jsonArray.getJSONObject(it))
@@ -289,6 +299,22 @@ object ButtonConfigManager {
         } catch (e: Exception) {
             emptyList()
         }
+        fnPinMask = fnMaskOf(configs)
+        return configs
+    }
+    
+    /**
+     * GPIO bit mask of the pins configured as FN modifiers. Cached, so it is
+     * cheap enough for every button snapshot.
+     */
+    fun getFnPinMask(context: Context): Int {
+        return fnPinMask ?: fnMaskOf(loadButtonConfigs(context))
+    }
+    
+    private fun fnMaskOf(configs: List<ButtonConfig>): Int {
+        return configs
+            .filter { it.idleFunction == ButtonFunction.FN_MODIFIER && it.gpioPin in 0 until 32 }
+            .fold(0) { bits, config -> bits or (1 shl config.gpioPin) }
     }
     
     /**
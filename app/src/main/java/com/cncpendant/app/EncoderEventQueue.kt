@@ -0,0 +1,244 @@
+package com.cncpendant.app
+
+import java.util.concurrent.TimeUnit
+import java.util.concurrent.locks.ReentrantLock
+import kotlin.concurrent.withLock
+
+/**
+ * Bounded hand-off of encoder events from the USB reader threads (serial
+ * and HID) to the encoder input thread.
+ *
+ * Entries live in a preallocated ring, so the hot path does not allocate.
+ * While the consumer is behind, an encoder event merges into an encoder
+ * event still waiting at the tail (deltas add up, count and velocity take
+ * the newest values); with the ring full it merges into the newest encoder
+ * entry anywhere in it instead of waiting. Button and chord events keep
+ * their order and, when the ring is full, the producer waits for room, but
+ * for at most [FULL_WAIT_LIMIT_MS] in all: a consumer that is stuck (a jog
+ * blocked on the socket) must not stall the USB reader and with it pings
+ * and heartbeats. An event that still finds no room is dropped and counted
+ * in [dropped].
+ *
+ * Each entry is stamped when queued and when taken. [take] records how long
+ * it waited in a fixed-bucket histogram, read with [waitStats]. Encoder
+ * entries also carry the reader's receive time and the firmware's
+ * timestamps for [LatencyMonitor]; a merge keeps those of the oldest event.
+ */
+class EncoderEventQueue(
+    private val capacity: Int = 64,
+    private val onReady: () -> Unit
+) {
+    companion object {
+        const val KIND_ENCODER = 1
+        const val KIND_BUTTON = 2
+        const val KIND_BUTTON_STATE = 3
+        const val KIND_CHORD = 4
+
+        // Upper bounds of the wait histogram buckets, microseconds; the last
+        // bucket holds everything longer
+        private val WAIT_BUCKETS_US = longArrayOf(100, 250, 500, 1000, 2000, 5000, 10000, 20000, 50000, 100000)
+        private const val FULL_WAIT_LIMIT_MS = 250L
+    }
+
+    class Entry {
+        var kind = 0
+        var delta = 0
+        var count = 0L
+        var velocity = 0f
+        var pin = 0             // Button pin or chord id
+        var pressed = false
+        var mask = 0
+        var changed = 0
+        var micros = 0L
+        var receivedAt = 0L     // System.nanoTime() when the reader got the bytes
+        var edgeMicros = -1L    // Device time of the first click, -1 if unknown
+        var txMicros = -1L      // Device time the report was written, -1 if unknown
+        var queuedAt = 0L       // System.nanoTime() when first queued
+        var takenAt = 0L        // System.nanoTime() when taken
+
+        fun copyFrom(other: Entry) {
+            kind = other.kind
+            delta = other.delta
+            count = other.count
+            velocity = other.velocity
+            pin = other.pin
+            pressed = other.pressed
+            mask = other.mask
+            changed = other.changed
+            micros = other.micros
+            receivedAt = other.receivedAt
+            edgeMicros = other.edgeMicros
+            txMicros = other.txMicros
+            queuedAt = other.queuedAt
+        }
+    }
+
+    private val lock = ReentrantLock()
+    private val notFull = lock.newCondition()
+    private val ring = Array(capacity) { Entry() }
+    private var head = 0
+    private var size = 0
+    private var closed = false
+    private val taken = Entry()     // Consumer's copy, valid until the next take()
+
+    // Producer side, under the lock
+    var coalesced = 0L
+        private set
+    var producerWaits = 0L
+        private set
+    var dropped = 0L
+        private set
+
+    // Consumer side
+    private val waitHistogram = LongArray(WAIT_BUCKETS_US.size + 1)
+    var handled = 0L
+        private set
+    private var waitTotalNs = 0L
+    private var waitMaxNs = 0L
+
+    fun putEncoder(delta: Int, count: Long, velocity: Float, receivedAt: Long, edgeMicros: Long, txMicros: Long) {
+        var ready = false
+        lock.withLock {
+            if (closed) return
+            if (size > 0) {
+                val tail = ring[(head + size - 1) % capacity]
+                if (tail.kind == KIND_ENCODER) {
+                    tail.delta += delta
+                    tail.count = count
+                    tail.velocity = velocity
+                    coalesced++
+                    return
+                }
+            }
+            if (size == capacity) {
+                // Full: fold into the newest waiting rotation rather than block
+                for (i in size - 2 downTo 0) {
+                    val older = ring[(head + i) % capacity]
+                    if (older.kind != KIND_ENCODER) continue
+                    older.delta += delta
+                    older.count = count
+                    older.velocity = velocity
+                    coalesced++
+                    return
+                }
+            }
+            val entry = reserve() ?: return
+            entry.kind = KIND_ENCODER
+            entry.delta = delta
+            entry.count = count
+            entry.velocity = velocity
+            entry.receivedAt = receivedAt
+            entry.edgeMicros = edgeMicros
+            entry.txMicros = txMicros
+            ready = size == 1
+        }
+        if (ready) onReady()
+    }
+
+    fun putButton(pin: Int, pressed: Boolean) = putInput(KIND_BUTTON, pin, pressed, 0, 0, 0)
+
+    fun putButtonSnapshot(mask: Int, changed: Int, micros: Long) =
+        putInput(KIND_BUTTON_STATE, 0, false, mask, changed, micros)
+
+    fun putChord(id: Int, pressed: Boolean) = putInput(KIND_CHORD, id, pressed, 0, 0, 0)
+
+    private fun putInput(kind: Int, pin: Int, pressed: Boolean, mask: Int, changed: Int, micros: Long) {
+        var ready = false
+        lock.withLock {
+            if (closed) return
+            val entry = reserve() ?: return
+            entry.kind = kind
+            entry.pin = pin
+            entry.pressed = pressed
+            entry.mask = mask
+            entry.changed = changed
+            entry.micros = micros
+            ready = size == 1
+        }
+        if (ready) onReady()
+    }
+
+    // Next free slot, waiting up to FULL_WAIT_LIMIT_MS while the ring is full;
+    // null (counted as dropped) if none frees up. Called with the lock held.
+    private fun reserve(): Entry? {
+        if (size == capacity) producerWaits++
+        var remainingNs = TimeUnit.MILLISECONDS.toNanos(FULL_WAIT_LIMIT_MS)
+        while (size == capacity) {
+            if (closed || remainingNs <= 0L) {
+                dropped++
+                return null
+            }
+            remainingNs = notFull.awaitNanos(remainingNs)
+        }
+        val entry = ring[(head + size) % capacity]
+        entry.queuedAt = System.nanoTime()
+        size++
+        return entry
+    }
+
+    /**
+     * Oldest event, or null when empty. The returned entry is reused by the
+     * next call. Consumer thread only.
+     */
+    fun take(): Entry? {
+        lock.withLock {
+            if (size == 0) return null
+            taken.copyFrom(ring[head])
+            head = (head + 1) % capacity
+            size--
+            notFull.signal()
+        }
+
+        taken.takenAt = System.nanoTime()
+        val waitNs = taken.takenAt - taken.queuedAt
+        handled++
+        waitTotalNs += waitNs
+        if (waitNs > waitMaxNs) waitMaxNs = waitNs
+        val waitUs = waitNs / 1000
+        var bucket = 0
+        while (bucket < WAIT_BUCKETS_US.size && waitUs > WAIT_BUCKETS_US[bucket]) bucket++
+        waitHistogram[bucket]++
+        return taken
+    }
+
+    /** Drop queued events and release a waiting producer (disconnect) */
+    fun clear() {
+        lock.withLock {
+            head = 0
+            size = 0
+            notFull.signalAll()
+        }
+    }
+
+    /** Stop accepting events for good */
+    fun close() {
+        lock.withLock {
+            closed = true
+            size = 0
+            notFull.signalAll()
+        }
+    }
+
+    /**
+     * Wait summary: handled events, mean, the bucket bound holding the 50th
+     * and 99th percentile, and the maximum. Call on the consumer thread.
+     */
+    fun waitStats(): String {
+        if (handled == 0L) return "no events"
+        return "$handled events, wait mean ${waitTotalNs / handled / 1000} us, " +
+            "p50 ${percentileLabel(0.50)}, p99 ${percentileLabel(0.99)}, max ${waitMaxNs / 1000} us, " +
+            "coalesced $coalesced, producer waits $producerWaits, dropped $dropped"
+    }
+
+    private fun percentileLabel(fraction: Double): String {
+        val rank = kotlin.math.ceil(handled * fraction).toLong()
+        var seen = 0L
+        for (i in waitHistogram.indices) {
+            seen += waitHistogram[i]
+            if (seen >= rank) {
+                return if (i < WAIT_BUCKETS_US.size) "<= ${WAIT_BUCKETS_US[i]} us" else "> ${WAIT_BUCKETS_US.last()} us"
+            }
+        }
+        return "> ${WAIT_BUCKETS_US.last()} us"
+    }
+}
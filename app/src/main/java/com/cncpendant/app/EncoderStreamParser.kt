@@ -0,0 +1,267 @@
+package com.cncpendant.app
+
+/**
+ * Incremental parser for the encoder firmware's JSON lines.
+ *
+ * Bytes are collected in one reusable buffer. At each newline the line is
+ * matched in place against the fixed shapes the firmware prints for its
+ * frequent messages (encoder, button, button_state, chord, pong, heartbeat),
+ * and a match fills the one preallocated [Event] without creating a String
+ * or JSONObject. Anything else (ready, command replies, firmware with a
+ * different field order) goes to [Sink.onOtherLine] for full JSON parsing.
+ *
+ * Pure Kotlin with no Android dependencies, so it also runs on a plain JVM
+ * (see app/benchmark/EncoderStreamBenchmark.kt). Not thread safe: feed it
+ * from the serial reader thread only.
+ */
+class EncoderStreamParser(private val sink: Sink) {
+
+    companion object {
+        const val MAX_LINE = 512    // Longer lines are dropped
+
+        const val KIND_ENCODER = 1
+        const val KIND_BUTTON = 2
+        const val KIND_BUTTON_STATE = 3
+        const val KIND_CHORD = 4
+        const val KIND_PONG = 5
+        const val KIND_HEARTBEAT = 6
+
+        private fun ascii(s: String) = s.toByteArray(Charsets.US_ASCII)
+
+        // Field order as printed by the firmware's send functions. "seq" is
+        // optional, for firmware from before sequence numbers.
+        private val TYPE = ascii("{\"type\":\"")
+        private val ENCODER = ascii("encoder\"")
+        private val BUTTON = ascii("button\"")
+        private val BUTTON_STATE = ascii("button_state\"")
+        private val CHORD = ascii("chord\"")
+        private val PONG = ascii("pong\"")
+        private val HEARTBEAT = ascii("heartbeat\"")
+        private val SEQ = ascii(",\"seq\":")
+        private val DELTA = ascii(",\"delta\":")
+        private val PIN = ascii(",\"pin\":")
+        private val MASK = ascii(",\"mask\":")
+        private val ID = ascii(",\"id\":")
+        private val POSITION = ascii(",\"position\":")
+        private val COUNT = ascii(",\"count\":")
+        private val VELOCITY = ascii(",\"velocity\":")
+        private val CHANGED = ascii(",\"changed\":")
+        private val TIME = ascii(",\"t\":")
+        private val TX_TIME = ascii(",\"tx\":")
+        private val PRESSED = ascii(",\"state\":\"pressed\"")
+        private val RELEASED = ascii(",\"state\":\"released\"")
+        private val CLOSE = ascii("}")
+    }
+
+    /** Reused for every message; copy the fields out before returning from [Sink.onEvent] */
+    class Event {
+        var kind = 0
+        var seq = -1L               // Event sequence number, -1 if the firmware sends none
+        var delta = 0
+        var position = 0L
+        var count = 0L              // Absolute count; older firmware sends none, then = position
+        var velocity = 0f
+        var pin = 0
+        var id = 0
+        var pressed = false
+        var mask = 0
+        var changed = 0
+        var micros = 0L             // Device micros(); for encoder and pong -1 if the firmware sends none
+        var txMicros = -1L          // Encoder: device micros() when written, -1 if not sent
+    }
+
+    interface Sink {
+        fun onEvent(event: Event)
+        /** A non-empty line that is not one of the fixed shapes; [line] is only valid during the call */
+        fun onOtherLine(line: ByteArray, length: Int)
+    }
+
+    private val line = ByteArray(MAX_LINE)
+    private var length = 0
+    private var overflow = false
+    private val event = Event()
+
+    // Match state for the line being parsed
+    private var pos = 0
+    private var end = 0
+    private var ok = true
+
+    var fastLines = 0L
+        private set
+    var otherLines = 0L
+        private set
+    var droppedLines = 0L
+        private set
+
+    fun accept(b: Byte) {
+        if (b != '\n'.code.toByte()) {
+            if (length < line.size) {
+                line[length++] = b
+            } else {
+                overflow = true
+            }
+            return
+        }
+
+        if (overflow) {
+            droppedLines++
+        } else {
+            processLine()
+        }
+        length = 0
+        overflow = false
+    }
+
+    fun accept(data: ByteArray, offset: Int = 0, count: Int = data.size) {
+        for (i in offset until offset + count) accept(data[i])
+    }
+
+    /** Drop any partial line (protocol switch, reconnect) */
+    fun reset() {
+        length = 0
+        overflow = false
+    }
+
+    private fun processLine() {
+        // Trim as the old String path did: the firmware ends lines with \r\n
+        var start = 0
+        end = length
+        while (end > 0 && line[end - 1] <= ' '.code.toByte()) end--
+        while (start < end && line[start] <= ' '.code.toByte()) start++
+        if (start == end) return
+
+        pos = start
+        ok = true
+        if (matchFixed()) {
+            fastLines++
+            sink.onEvent(event)
+        } else {
+            otherLines++
+            if (start > 0) System.arraycopy(line, start, line, 0, end - start)
+            sink.onOtherLine(line, end - start)
+        }
+    }
+
+    private fun matchFixed(): Boolean {
+        if (!match(TYPE)) return false
+        val e = event
+        when {
+            match(ENCODER) -> {
+                e.kind = KIND_ENCODER
+                e.seq = sequence()
+                expect(DELTA)
+                e.delta = number().toInt()
+                expect(POSITION)
+                e.position = number()
+                e.count = if (match(COUNT)) number() else e.position
+                expect(VELOCITY)
+                e.velocity = decimal()
+                e.micros = if (match(TIME)) number() else -1L
+                e.txMicros = if (match(TX_TIME)) number() else -1L
+            }
+            match(BUTTON) -> {
+                e.kind = KIND_BUTTON
+                e.seq = sequence()
+                expect(PIN)
+                e.pin = number().toInt()
+                e.pressed = pressedState()
+            }
+            match(BUTTON_STATE) -> {
+                e.kind = KIND_BUTTON_STATE
+                e.seq = sequence()
+                expect(MASK)
+                e.mask = number().toInt()
+                expect(CHANGED)
+                e.changed = number().toInt()
+                expect(TIME)
+                e.micros = number()
+            }
+            match(CHORD) -> {
+                e.kind = KIND_CHORD
+                e.seq = sequence()
+                expect(ID)
+                e.id = number().toInt()
+                e.pressed = pressedState()
+                expect(TIME)
+                e.micros = number()
+            }
+            match(PONG) -> {
+                e.kind = KIND_PONG
+                e.seq = -1
+                expect(POSITION)
+                e.position = number()
+                e.count = if (match(COUNT)) number() else e.position
+                e.micros = if (match(TIME)) number() else -1L
+            }
+            match(HEARTBEAT) -> {
+                // Only the last event sequence number matters to the app
+                e.kind = KIND_HEARTBEAT
+                e.seq = sequence()
+                return ok
+            }
+            else -> return false
+        }
+        return ok && match(CLOSE) && pos == end
+    }
+
+    private fun match(token: ByteArray): Boolean {
+        if (end - pos < token.size) return false
+        for (i in token.indices) {
+            if (line[pos + i] != token[i]) return false
+        }
+        pos += token.size
+        return true
+    }
+
+    private fun sequence(): Long = if (match(SEQ)) number() else -1L
+
+    private fun expect(token: ByteArray) {
+        if (!match(token)) ok = false
+    }
+
+    private fun pressedState(): Boolean {
+        if (match(PRESSED)) return true
+        if (!match(RELEASED)) ok = false
+        return false
+    }
+
+    // Optionally signed integer of up to 18 digits
+    private fun number(): Long {
+        val negative = pos < end && line[pos] == '-'.code.toByte()
+        if (negative) pos++
+        val start = pos
+        var value = 0L
+        while (pos < end) {
+            val digit = line[pos] - '0'.code.toByte()
+            if (digit < 0 || digit > 9) break
+            value = value * 10 + digit
+            pos++
+        }
+        if (pos == start || pos - start > 18) ok = false
+        return if (negative) -value else value
+    }
+
+    // Decimal as printed by the firmware (fixed1), e.g. -12.5
+    private fun decimal(): Float {
+        val negative = pos < end && line[pos] == '-'.code.toByte()
+        if (negative) pos++
+        val whole = number()
+        if (whole < 0) ok = false
+        var fraction = 0f
+        if (pos < end && line[pos] == '.'.code.toByte()) {
+            pos++
+            var scale = 0.1f
+            val start = pos
+            while (pos < end) {
+                val digit = line[pos] - '0'.code.toByte()
+                if (digit < 0 || digit > 9) break
+                fraction += digit * scale
+                scale *= 0.1f
+                pos++
+            }
+            if (pos == start) ok = false
+        }
+        val value = whole + fraction
+        return if (negative) -value else value
+    }
+}
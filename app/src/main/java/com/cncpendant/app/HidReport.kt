@@ -0,0 +1,98 @@
+package com.cncpendant.app
+
+import android.hardware.usb.UsbConstants
+import android.hardware.usb.UsbDevice
+import android.hardware.usb.UsbDeviceConnection
+import android.hardware.usb.UsbEndpoint
+import android.hardware.usb.UsbInterface
+import android.util.Log
+
+/**
+ * Vendor HID input report of the RP2040 encoder firmware's HID builds
+ * (mirror of rp2040-encoder/src/hid_report.h).
+ *
+ * A fixed 16-byte little-endian snapshot, no report ID:
+ * seq, flags, int16 delta, int32 count (low 32 bits), int16 velocity (0.1 counts/s),
+ * uint32 button mask, uint16 dial position.
+ */
+object HidReport {
+    const val SIZE = 16
+    const val FLAG_BUTTONS_CHANGED = 0x01
+
+    fun sequence(report: ByteArray) = report[0].toInt() and 0xFF
+    fun flags(report: ByteArray) = report[1].toInt() and 0xFF
+    fun delta(report: ByteArray) = BinaryProtocol.le16(report, 2).toShort().toInt()
+    fun count(report: ByteArray) = BinaryProtocol.le32(report, 4)
+    fun velocity(report: ByteArray) = BinaryProtocol.le16(report, 8).toShort() / 10f
+    fun buttons(report: ByteArray) = BinaryProtocol.le32(report, 10)
+    fun position(report: ByteArray) = BinaryProtocol.le16(report, 14)
+}
+
+/**
+ * Reads the encoder's HID interrupt endpoint on its own thread. The CDC port
+ * stays open for commands; only events move to this endpoint, which the
+ * host polls every 1 ms instead of waiting on the serial bulk pipe.
+ */
+class HidReportReader(
+    private val connection: UsbDeviceConnection,
+    private val onReport: (ByteArray) -> Unit
+) {
+    companion object {
+        private const val TAG = "HidReportReader"
+        private const val READ_TIMEOUT_MS = 100
+    }
+
+    private var hidInterface: UsbInterface? = null
+    private var endpoint: UsbEndpoint? = null
+    @Volatile private var running = false
+    private var thread: Thread? = null
+
+    /**
+     * Claim the device's HID interface and start reading.
+     * @return false if the device has no HID interface with an interrupt IN endpoint
+     */
+    fun start(device: UsbDevice): Boolean {
+        for (i in 0 until device.interfaceCount) {
+            val intf = device.getInterface(i)
+            if (intf.interfaceClass != UsbConstants.USB_CLASS_HID) continue
+            for (e in 0 until intf.endpointCount) {
+                val ep = intf.getEndpoint(e)
+                if (ep.type == UsbConstants.USB_ENDPOINT_XFER_INT && ep.direction == UsbConstants.USB_DIR_IN) {
+                    hidInterface = intf
+                    endpoint = ep
+                }
+            }
+            if (endpoint != null) break
+        }
+        val intf = hidInterface ?: return false
+        val ep = endpoint ?: return false
+        if (!connection.claimInterface(intf, true)) {
+            Log.w(TAG, "Could not claim HID interface")
+            return false
+        }
+
+        running = true
+        thread = Thread({ readLoop(ep) }, "EncoderHid").apply { start() }
+        Log.d(TAG, "Reading HID reports from endpoint 0x${ep.address.toString(16)}")
+        return true
+    }
+
+    fun stop() {
+        running = false
+        thread?.join(READ_TIMEOUT_MS * 2L)
+        thread = null
+        hidInterface?.let { connection.releaseInterface(it) }
+        hidInterface = null
+        endpoint = null
+    }
+
+    private fun readLoop(ep: UsbEndpoint) {
+        val buffer = ByteArray(maxOf(ep.maxPacketSize, HidReport.SIZE))
+        while (running) {
+            val n = connection.bulkTransfer(ep, buffer, buffer.size, READ_TIMEOUT_MS)
+            if (n >= HidReport.SIZE) {
+                onReport(buffer)
+            }
+        }
+    }
+}
@@ -10,10 +10,13 @@ import android.graphics.RectF
 import android.graphics.Shader
 import android.graphics.Typeface
 import android.util.AttributeSet
+import android.view.Choreographer
 import android.view.MotionEvent
 import android.view.View
 import android.os.Handler
 import android.os.Looper
+import android.os.SystemClock
+import java.util.concurrent.atomic.AtomicBoolean
 import kotlin.math.atan2
 import kotlin.math.cos
 import kotlin.math.sin
@@ -71,6 +74,13 @@ class JogDialView @JvmOverloads constructor(
         strokeWidth = 4f
     }
 
+    // Brushed metal lines on the dial face
+    private val brushPaint = Paint(Paint.ANTI_ALIAS_FLAG).apply {
+        color = Color.parseColor("#55ffffff")
+        style = Paint.Style.STROKE
+        strokeWidth = 1f
+    }
+
     // Indicator mark on the metallic center
     private val indicatorPaint = Paint(Paint.ANTI_ALIAS_FLAG).apply {
         color = Color.parseColor("#e74c3c")
@@ -121,6 +131,38 @@ class JogDialView @JvmOverloads constructor(
         pendingClicks = 0
     }
 
+    // Encoder position slot: written by the encoder input thread, read once
+    // per display frame. A seqlock over volatile fields, so neither side
+    // blocks or allocates; the writer is the only one that changes encoderSeq.
+    @Volatile private var encoderSeq = 0
+    @Volatile private var slotCount = 0L
+    @Volatile private var slotCountsPerRev = 0
+    @Volatile private var slotVelocity = 0f
+    private val frameRequested = AtomicBoolean(false)
+    private val mainHandler = Handler(Looper.getMainLooper())
+    private val requestFrame = Runnable { Choreographer.getInstance().postFrameCallback(frameCallback) }
+    private val frameCallback = Choreographer.FrameCallback { onEncoderFrame(it) }
+
+    // Dial animation, main thread: the shown count runs toward the latest
+    // one at the wheel's measured speed, so it never passes it
+    private var shownCount = 0.0
+    private var shownCountsPerRev = 0
+    private var lastFrameNanos = 0L
+    private val MAX_FRAME_STEP_NS = 50_000_000L     // Longer gaps (first frame, stalls) count as one of these
+    private val MAX_LAG_S = 0.1                     // Catch up at once when further behind than this
+    private val MIN_CATCH_UP_RATE = 20.0            // counts/s, so a slow wheel does not trail far behind
+
+    // Frame instrumentation (main thread); read with encoderFrameStats()
+    private var statUpdates = 0L                    // Written by the input thread; approximate
+    private var statFrames = 0L
+    private var statInvalidations = 0L
+    private var statSlowFrames = 0L                 // Frame interval over 1.5x the display refresh
+    private var statMaxFrameIntervalNs = 0L
+    private var statDraws = 0L
+    private var statDrawTotalNs = 0L
+    private var statDrawMaxNs = 0L
+    private var statStartedAt = SystemClock.elapsedRealtime()
+
     private var jogListener: ((clicks: Int, direction: Int) -> Unit)? = null
     private var continuousJogStartListener: ((direction: Int) -> Unit)? = null
     private var continuousJogStopListener: (() -> Unit)? = null
@@ -158,17 +200,117 @@ class JogDialView @JvmOverloads constructor(
     }
     
     /**
-     * Set the dial rotation to match an absolute encoder position.
-     * This keeps the dial in sync even if some encoder events are dropped.
-     * @param position The absolute encoder position in ticks
+     * Move the dial to an absolute encoder count. Safe to call from one
+     * non-UI thread (the encoder input thread): the value goes into a
+     * latest-value slot that the next display frame consumes, so a burst of
+     * events costs one redraw per frame. Following the absolute count keeps
+     * the dial in sync even if some encoder events are dropped, and the angle
+     * follows the physical wheel, so an encoder whose resolution differs from
+     * numTicks still turns the dial once per revolution.
+     * @param count The absolute encoder count
+     * @param countsPerRev Encoder counts per revolution (PPR x decode)
+     * @param velocity Wheel speed in counts/s; the dial turns toward the new
+     *        count at this speed. 0 or NaN jumps straight to it.
      */
-    fun syncToEncoderPosition(position: Long) {
-        // Map encoder position to dial rotation (modulo numTicks)
-        val tickPosition = (position % numTicks).toInt()
-        // Handle negative positions correctly
-        val normalizedTick = if (tickPosition < 0) tickPosition + numTicks else tickPosition
-        dialRotation = normalizedTick * degreesPerTick
-        invalidate()
+    fun postEncoderPosition(count: Long, countsPerRev: Int, velocity: Float) {
+        if (countsPerRev <= 0) return
+        encoderSeq++                    // Odd: write in progress
+        slotCount = count
+        slotCountsPerRev = countsPerRev
+        slotVelocity = if (velocity.isNaN()) 0f else kotlin.math.abs(velocity)
+        encoderSeq++
+        statUpdates++
+        if (frameRequested.compareAndSet(false, true)) mainHandler.post(requestFrame)
+    }
+
+    private fun onEncoderFrame(frameTimeNanos: Long) {
+        // Clear before reading: a post that lands after the read below
+        // schedules another frame instead of being lost
+        frameRequested.set(false)
+
+        // Latest slot contents; retry if the writer was mid-update
+        var count: Long
+        var countsPerRev: Int
+        var velocity: Float
+        while (true) {
+            val seq = encoderSeq
+            count = slotCount
+            countsPerRev = slotCountsPerRev
+            velocity = slotVelocity
+            if ((seq and 1) == 0 && seq == encoderSeq) break
+        }
+
+        statFrames++
+        val interval = if (lastFrameNanos == 0L) 0L else frameTimeNanos - lastFrameNanos
+        if (interval > statMaxFrameIntervalNs) statMaxFrameIntervalNs = interval
+        val refreshNanos = (1e9 / (display?.refreshRate ?: 60f)).toLong()
+        if (interval > refreshNanos * 3 / 2) statSlowFrames++
+
+        val target = count.toDouble()
+        val lag = target - shownCount
+        if (countsPerRev != shownCountsPerRev || velocity == 0f) {
+            shownCount = target
+        } else {
+            // The first frame of a movement advances by one refresh period
+            val elapsed = if (interval == 0L) refreshNanos else minOf(interval, MAX_FRAME_STEP_NS)
+            val rate = maxOf(velocity.toDouble(), MIN_CATCH_UP_RATE)
+            val step = rate * elapsed / 1e9
+            shownCount = when {
+                kotlin.math.abs(lag) <= step || kotlin.math.abs(lag) > rate * MAX_LAG_S + 1 -> target
+                lag > 0 -> shownCount + step
+                else -> shownCount - step
+            }
+        }
+        shownCountsPerRev = countsPerRev
+
+        val countInRev = ((shownCount % countsPerRev) + countsPerRev) % countsPerRev
+        val rotation = (countInRev * 360.0 / countsPerRev).toFloat()
+        if (rotation != dialRotation) {
+            dialRotation = rotation
+            statInvalidations++
+            invalidate()
+        }
+
+        // Keep animating until the dial reaches the latest count
+        if (shownCount != target) {
+            lastFrameNanos = frameTimeNanos
+            if (frameRequested.compareAndSet(false, true)) {
+                Choreographer.getInstance().postFrameCallback(frameCallback)
+            }
+        } else {
+            lastFrameNanos = 0L
+        }
+    }
+
+    /** Frame statistics since the last reset, for the encoder dial */
+    fun encoderFrameStats(): String {
+        val seconds = (SystemClock.elapsedRealtime() - statStartedAt) / 1000.0
+        val drawAvgUs = if (statDraws > 0) statDrawTotalNs / statDraws / 1000 else 0
+        return String.format(
+            "%.1f s: %d encoder updates, %d frames, %d redraws, %d slow frames (max interval %.1f ms), draw avg %d us max %d us",
+            seconds, statUpdates, statFrames, statInvalidations, statSlowFrames,
+            statMaxFrameIntervalNs / 1e6, drawAvgUs, statDrawMaxNs / 1000
+        )
+    }
+
+    fun resetEncoderFrameStats() {
+        statUpdates = 0
+        statFrames = 0
+        statInvalidations = 0
+        statSlowFrames = 0
+        statMaxFrameIntervalNs = 0
+        statDraws = 0
+        statDrawTotalNs = 0
+        statDrawMaxNs = 0
+        statStartedAt = SystemClock.elapsedRealtime()
+    }
+
+    override fun onDetachedFromWindow() {
+        super.onDetachedFromWindow()
+        mainHandler.removeCallbacks(requestFrame)
+        Choreographer.getInstance().removeFrameCallback(frameCallback)
+        frameRequested.set(false)
+        lastFrameNanos = 0L
     }
 
     override fun onSizeChanged(w: Int, h: Int, oldw: Int, oldh: Int) {
@@ -198,7 +340,16 @@ class JogDialView @JvmOverloads constructor(
     }
 
     override fun onDraw(canvas: Canvas) {
+        val drawStart = System.nanoTime()
         super.onDraw(canvas)
+        drawDial(canvas)
+        val drawNs = System.nanoTime() - drawStart
+        statDraws++
+        statDrawTotalNs += drawNs
+        if (drawNs > statDrawMaxNs) statDrawMaxNs = drawNs
+    }
+
+    private fun drawDial(canvas: Canvas) {
 
         // Major tick interval: every 5 for 50 ticks, every 10 for 100 ticks
         val majorInterval = numTicks / 10
@@ -246,11 +397,6 @@ class JogDialView @JvmOverloads constructor(
         canvas.drawCircle(centerX, centerY, innerRadius, dialPaint)
         
         // Draw subtle radial lines on metallic surface for brushed metal effect
-        val brushPaint = Paint(Paint.ANTI_ALIAS_FLAG).apply {
-            color = Color.parseColor("#55ffffff")
-            style = Paint.Style.STROKE
-            strokeWidth = 1f
-        }
         for (i in 0 until 60) {
             val angle = Math.toRadians(i * 6.0)
             val x1 = centerX + cos(angle).toFloat() * (innerRadius * 0.15f)
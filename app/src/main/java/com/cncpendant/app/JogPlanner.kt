@@ -0,0 +1,140 @@
+package com.cncpendant.app
+
+/**
+ * Streaming jog planner for the handwheel.
+ *
+ * Clicks add distance owed to the machine; [poll] hands it out as short
+ * `$J=G91` segments whose feed follows the wheel speed measured by the
+ * firmware. Segments last about [segmentMs] each, and a new one is issued
+ * only while the motion already sent is estimated to finish within
+ * [targetLatencyMs], so GRBL always has the next block queued but never
+ * more than that window of travel.
+ *
+ * Distance that would go beyond the window (the wheel outrunning the feed
+ * cap) is dropped and counted in [distanceDropped], so after the wheel stops
+ * the machine travels at most one window at the current feed, or one step if
+ * that is larger. The caller tells the operator when that happens; dropped
+ * travel is never made up later.
+ * Reversing lets the queued window finish and then moves back; nothing is
+ * cancelled, so every kept click is travelled exactly.
+ *
+ * The time estimate assumes GRBL runs each segment at its feed plus one
+ * acceleration ramp from rest, so the feed cap must not exceed the
+ * machine's max rate ($110..$112). Pure Kotlin with no Android dependencies;
+ * JogPlannerSimulationTest drives it against a GRBL planner model.
+ *
+ * Not thread safe. MainActivity owns its planner on the "EncoderInput"
+ * thread (UsbEncoderManager.inputHandler): clicks, polls, the drain timer,
+ * resets and the stats read all run there, never on the main thread.
+ */
+class JogPlanner(
+    private val targetLatencyMs: Long = 200,
+    private val segmentMs: Long = 50,
+    private val accel: Float = 500f     // mm/s², only for the time estimate
+) {
+    companion object {
+        const val MIN_FEED = 10f        // mm/min; slower wheels move in steps
+        private const val RESOLUTION = 0.001   // Jog commands carry 3 decimals
+    }
+
+    /** Reused for every segment; send it before the next [poll] */
+    class Segment {
+        var distance = 0f               // Signed mm
+        var feed = 0                    // mm/min
+    }
+
+    private val segment = Segment()
+    private var owed = 0.0              // Clicked but not yet sent, signed mm
+    private var feed = 0f               // Current feed, mm/min
+    private var queuedUntil = 0L        // Estimated end of the motion already sent
+
+    var segmentsSent = 0L
+        private set
+    var distanceSent = 0.0
+        private set
+    var distanceDropped = 0.0
+        private set
+
+    /** Distance still to be sent */
+    val hasPending: Boolean get() = owed != 0.0
+
+    /**
+     * Add wheel movement.
+     * @param clicks signed clicks since the last call
+     * @param step jog distance per click, mm
+     * @param velocity wheel speed in clicks/s from the firmware; 0 or NaN (first
+     *        click after rest, or unknown) moves at [maxFeed] like a step jog
+     * @param maxFeed feed cap, mm/min
+     */
+    fun addClicks(clicks: Int, step: Float, velocity: Float, maxFeed: Int, nowMs: Long) {
+        val cap = maxFeed.toFloat().coerceAtLeast(MIN_FEED)
+        feed = if (velocity.isNaN() || velocity == 0f) {
+            cap
+        } else {
+            (kotlin.math.abs(velocity) * step * 60f).coerceIn(MIN_FEED, cap)
+        }
+
+        owed += clicks.toDouble() * step
+        if (owed in -RESOLUTION / 2..RESOLUTION / 2) {
+            owed = 0.0
+            return
+        }
+
+        // Keep queued plus owed travel within one latency window at this feed
+        val mmPerMs = feed / 60000.0
+        val limit = maxOf(step.toDouble(), mmPerMs * (targetLatencyMs - queuedMs(nowMs)))
+        val excess = kotlin.math.abs(owed) - limit
+        if (excess > 0) {
+            distanceDropped += excess
+            owed = if (owed > 0) limit else -limit
+        }
+    }
+
+    /**
+     * Next segment to send, or null while the queue is full or nothing is
+     * owed. Call after [addClicks] and then every few tens of milliseconds
+     * while [hasPending].
+     */
+    fun poll(nowMs: Long): Segment? {
+        if (owed == 0.0) return null
+        val queued = queuedMs(nowMs)
+        if (queued > targetLatencyMs - segmentMs) return null
+
+        // One segment's worth at the current feed; a short tail rides along
+        val mmPerMs = feed / 60000.0
+        val remaining = kotlin.math.abs(owed)
+        var length = minOf(remaining, mmPerMs * segmentMs)
+        if (remaining - length < length / 2) length = remaining
+        length = Math.round(length / RESOLUTION) * RESOLUTION
+        if (length <= 0.0) {
+            owed = 0.0
+            return null
+        }
+
+        var durationMs = length / mmPerMs
+        if (queued == 0L) {
+            // Starting from rest: GRBL spends v / 2a longer on the ramp
+            durationMs += (feed / 60f) / (2f * accel) * 1000f
+        }
+        queuedUntil = maxOf(queuedUntil, nowMs) + durationMs.toLong()
+
+        val signed = if (owed > 0) length else -length
+        owed -= signed
+        if (kotlin.math.abs(owed) < RESOLUTION / 2) owed = 0.0
+        segmentsSent++
+        distanceSent += length
+
+        segment.distance = signed.toFloat()
+        segment.feed = Math.round(feed)
+        return segment
+    }
+
+    /** Estimated time until the motion already sent has finished */
+    fun queuedMs(nowMs: Long): Long = maxOf(0L, queuedUntil - nowMs)
+
+    /** Forget owed distance (axis change, jogging disabled); counted as dropped */
+    fun reset() {
+        distanceDropped += kotlin.math.abs(owed)
+        owed = 0.0
+    }
+}
@@ -0,0 +1,243 @@
+package com.cncpendant.app
+
+/**
+ * Per-stage latency of handwheel input, from the encoder edge on the device
+ * to the jog command handed to the WebSocket.
+ *
+ * Stages, each kept in a fixed-bucket histogram:
+ *
+ *   firmware  first click of a report -> report written (device clock)
+ *   usb       report written -> bytes delivered to the app (clock offset)
+ *   parse     bytes delivered -> event queued for the input thread
+ *   queue     queued -> taken by the input thread
+ *   handle    taken -> jog command started (planner, step jog rate limit,
+ *             the main thread hop for older firmware)
+ *   send      WebSocketManager.sendJogCommand itself
+ *   host      bytes delivered -> jog command sent
+ *   total     encoder edge -> jog command sent (clock offset)
+ *
+ * Device times are the firmware's 32-bit micros(). They are mapped to
+ * System.nanoTime() with a ping/pong offset estimate: of the pongs seen in
+ * the last [SYNC_WINDOW_NS], the one with the shortest round trip wins, and
+ * half its round trip bounds the error. Stages needing the offset are
+ * skipped until the first pong.
+ *
+ * A jog command is charged to the oldest encoder event since the previous
+ * one, so handle and total include the time clicks wait for the planner or
+ * the step jog rate limit. Commands without new clicks (later planner
+ * segments) only count towards send.
+ *
+ * Off by default; while [enabled] is false the callers only read the flag.
+ * Thread safe: events are taken on the input thread and jogs may be sent
+ * from the main thread.
+ */
+class LatencyMonitor {
+    companion object {
+        // Upper bounds of the histogram buckets, microseconds; the last
+        // bucket holds everything longer
+        private val BUCKETS_US = longArrayOf(
+            10, 20, 50, 100, 150, 200, 300, 500, 700,
+            1000, 1500, 2000, 3000, 5000, 7000,
+            10000, 15000, 20000, 30000, 50000, 70000,
+            100000, 150000, 200000, 300000, 500000, 1000000
+        )
+        private const val SYNC_SAMPLES = 8
+        private const val SYNC_WINDOW_NS = 20_000_000_000L
+        // An event older than this without a jog was not turned into one
+        private const val STALE_EVENT_NS = 1_000_000_000L
+    }
+
+    enum class Stage(val label: String) {
+        FIRMWARE("firmware"),
+        USB("usb"),
+        PARSE("parse"),
+        QUEUE("queue"),
+        HANDLE("handle"),
+        SEND("send"),
+        HOST("host"),
+        TOTAL("total")
+    }
+
+    private class Histogram {
+        val buckets = LongArray(BUCKETS_US.size + 1)
+        var count = 0L
+        var totalUs = 0L
+        var maxUs = 0L
+
+        fun add(us: Long) {
+            var bucket = 0
+            while (bucket < BUCKETS_US.size && us > BUCKETS_US[bucket]) bucket++
+            buckets[bucket]++
+            count++
+            totalUs += us
+            if (us > maxUs) maxUs = us
+        }
+
+        fun clear() {
+            buckets.fill(0)
+            count = 0
+            totalUs = 0
+            maxUs = 0
+        }
+
+        fun percentileLabel(fraction: Double): String {
+            val rank = kotlin.math.ceil(count * fraction).toLong()
+            var seen = 0L
+            for (i in buckets.indices) {
+                seen += buckets[i]
+                if (seen >= rank) {
+                    return if (i < BUCKETS_US.size) "<=${BUCKETS_US[i]}" else ">${BUCKETS_US.last()}"
+                }
+            }
+            return ">${BUCKETS_US.last()}"
+        }
+    }
+
+    @Volatile var enabled = false
+
+    private val histograms = Array(Stage.values().size) { Histogram() }
+
+    // Clock sync samples: round trip, host midpoint, device micros
+    private val syncRtt = LongArray(SYNC_SAMPLES)
+    private val syncHostNs = LongArray(SYNC_SAMPLES)
+    private val syncDevice = LongArray(SYNC_SAMPLES)
+    private var syncCount = 0
+    private var syncNext = 0
+    private var pingSentAt = 0L
+    private var offsetValid = false
+    private var offsetHostNs = 0L
+    private var offsetDevice = 0L
+    private var offsetRttNs = 0L
+
+    // Oldest encoder event not yet turned into a jog command
+    private var pending = false
+    private var pendingEdgeNs = 0L      // 0 = device time unknown
+    private var pendingReceivedNs = 0L
+    private var pendingTakenNs = 0L
+
+    private var startedAt = System.nanoTime()
+    private var clampedSamples = 0L
+
+    @Synchronized
+    fun pingSent(nowNs: Long) {
+        pingSentAt = nowNs
+    }
+
+    /** A pong carrying the device's micros() arrived at [receivedNs] */
+    @Synchronized
+    fun pongReceived(deviceMicros: Long, receivedNs: Long) {
+        val sentAt = pingSentAt
+        if (sentAt == 0L || deviceMicros < 0) return
+        pingSentAt = 0
+        val rtt = receivedNs - sentAt
+        if (rtt < 0) return
+
+        syncRtt[syncNext] = rtt
+        syncHostNs[syncNext] = sentAt + rtt / 2
+        syncDevice[syncNext] = deviceMicros
+        syncNext = (syncNext + 1) % SYNC_SAMPLES
+        if (syncCount < SYNC_SAMPLES) syncCount++
+
+        var best = -1
+        for (i in 0 until syncCount) {
+            if (receivedNs - syncHostNs[i] > SYNC_WINDOW_NS) continue
+            if (best < 0 || syncRtt[i] < syncRtt[best]) best = i
+        }
+        if (best < 0) return
+        offsetValid = true
+        offsetHostNs = syncHostNs[best]
+        offsetDevice = syncDevice[best]
+        offsetRttNs = syncRtt[best]
+    }
+
+    // Device micros (32-bit, wrapping) on the nanoTime() scale. Called with the lock held.
+    private fun deviceToHostNs(deviceMicros: Long): Long =
+        offsetHostNs + (deviceMicros - offsetDevice).toInt().toLong() * 1000L
+
+    /**
+     * An encoder event reached the input thread.
+     * @param edgeMicros device time of its first click, -1 if not reported
+     * @param txMicros device time it was written, -1 if not reported
+     */
+    @Synchronized
+    fun eventTaken(edgeMicros: Long, txMicros: Long, receivedNs: Long, queuedNs: Long, takenNs: Long) {
+        if (edgeMicros >= 0 && txMicros >= 0) {
+            record(Stage.FIRMWARE, (txMicros - edgeMicros).toInt().toLong() * 1000L)
+        }
+        if (txMicros >= 0 && offsetValid) {
+            record(Stage.USB, receivedNs - deviceToHostNs(txMicros))
+        }
+        record(Stage.PARSE, queuedNs - receivedNs)
+        record(Stage.QUEUE, takenNs - queuedNs)
+
+        if (!pending || takenNs - pendingTakenNs > STALE_EVENT_NS) {
+            pending = true
+            pendingEdgeNs = if (edgeMicros >= 0 && offsetValid) deviceToHostNs(edgeMicros) else 0L
+            pendingReceivedNs = receivedNs
+            pendingTakenNs = takenNs
+        }
+    }
+
+    /** A jog command driven by the wheel took from [startNs] to [endNs] to send */
+    @Synchronized
+    fun jogSent(startNs: Long, endNs: Long) {
+        record(Stage.SEND, endNs - startNs)
+        if (!pending) return
+        pending = false
+        record(Stage.HANDLE, startNs - pendingTakenNs)
+        record(Stage.HOST, endNs - pendingReceivedNs)
+        if (pendingEdgeNs != 0L) record(Stage.TOTAL, endNs - pendingEdgeNs)
+    }
+
+    // Called with the lock held. Offset error can push a stage slightly below zero.
+    private fun record(stage: Stage, ns: Long) {
+        val us = if (ns < 0) {
+            clampedSamples++
+            0L
+        } else {
+            ns / 1000
+        }
+        histograms[stage.ordinal].add(us)
+    }
+
+    /** Clear the histograms; the clock offset is kept */
+    @Synchronized
+    fun reset() {
+        for (h in histograms) h.clear()
+        pending = false
+        clampedSamples = 0
+        startedAt = System.nanoTime()
+    }
+
+    /** Forget the clock offset (device reconnected or restarted) */
+    @Synchronized
+    fun resetClock() {
+        syncCount = 0
+        syncNext = 0
+        pingSentAt = 0
+        offsetValid = false
+        pending = false
+    }
+
+    /** One line per stage: samples, p50, p99 and max in microseconds */
+    @Synchronized
+    fun report(): String {
+        val sb = StringBuilder()
+        val seconds = (System.nanoTime() - startedAt) / 1_000_000_000L
+        sb.append("latency us over ${seconds}s, clock ")
+        if (offsetValid) sb.append("+/-${offsetRttNs / 2000}") else sb.append("not synced")
+        if (clampedSamples > 0) sb.append(", $clampedSamples clamped")
+        sb.append('\n')
+        for (stage in Stage.values()) {
+            val h = histograms[stage.ordinal]
+            sb.append(String.format("%-8s", stage.label))
+            if (h.count == 0L) {
+                sb.append(" -\n")
+                continue
+            }
+            sb.append(String.format(" n=%d mean=%d p50%s p99%s max=%d\n",
+                h.count, h.totalUs / h.count, h.percentileLabel(0.50), h.percentileLabel(0.99), h.maxUs))
+        }
+        return sb.toString()
+    }
+}
@@ -32,6 +32,7 @@ import android.widget.SeekBar
 import android.widget.ArrayAdapter
 import android.widget.Spinner
 import androidx.appcompat.app.AlertDialog
+import com.google.android.material.switchmaterial.SwitchMaterial
 import com.google.android.material.tabs.TabLayout
 import com.google.gson.Gson
 import kotlinx.coroutines.*
@@ -68,6 +69,46 @@ class MainActivity : AppCompatActivity() {
     private var lastEncoderJogSentAt = 0L
     private val ENCODER_MIN_SEND_INTERVAL_MS = 100L
     
+    // Step jog accumulator: clicks that arrive inside the send interval or the
+    // jog cooldown are queued and sent as one merged jog when the window opens
+    private var encoderPendingClicks = 0          // Signed; reversals cancel out
+    private var encoderPendingDistance = 0f
+    private var encoderPendingAxis = ""
+    private var encoderFlushRunnable: Runnable? = null
+    // Safety bound on queued travel, mm (at least one step); clicks beyond it are
+    // dropped. Step sizes are mm and encoder jogs carry G21, so the bound holds
+    // with the machine in G20 too.
+    private val ENCODER_MAX_PENDING_DISTANCE_MM = 20f
+    
+    // Streaming jogs for firmware that reports wheel speed: the planner turns
+    // clicks into short segments at the wheel's feed (see JogPlanner). Used
+    // only on the encoder input thread, timers included.
+    private val jogPlanner = JogPlanner()
+    private var jogPlannerAxis = ""
+    private var jogPlannerRunnable: Runnable? = null
+    private val JOG_PLANNER_TICK_MS = 20L
+    private var plannerClickAt = 0L
+    // Travel the planner dropped is announced (buzz and toast), at most once
+    // per interval; drops in between add up into the next notice
+    private var jogDropNoticed = 0.0              // Part of distanceDropped already announced
+    private var jogDropNoticeAt = 0L
+    private var jogDropNoticeRunnable: Runnable? = null
+    private val JOG_DROP_NOTICE_INTERVAL_MS = 2000L
+    private val JOG_DROP_MIN_NOTICE_MM = 0.01
+    
+    // Latency overlay (Settings > Diagnostics); tracking runs while it is shown
+    private var latencyOverlayRunnable: Runnable? = null
+    private val LATENCY_OVERLAY_REFRESH_MS = 500L
+    
+    // Step jog accounting: clicks received = commanded + dropped + cancelled + pending,
+    // where cancelled counts both clicks of each pair a reversal cancels
+    private var encoderClicksReceived = 0L
+    private var encoderClicksCommanded = 0L
+    private var encoderClicksDropped = 0L
+    private var encoderClicksCancelled = 0L
+    private var encoderJogsSent = 0L
+    private var encoderDistanceCommanded = 0.0
+    
     // Encoder continuous jog support
     private var encoderContinuousJogging = false
     private var encoderContinuousDirection = 0
@@ -91,14 +132,15 @@ class MainActivity : AppCompatActivity() {
         uri?.let { writeFirmwareToUri(it) }
     }
 
-    private var selectedAxis: String = ""
-    private var currentStep: Float = 0.05f
-    private var currentFeedRate: Int = 500
+    // Volatile where the encoder input thread reads them (see handleEncoderInput)
+    @Volatile private var selectedAxis: String = ""
+    @Volatile private var currentStep: Float = 0.05f
+    @Volatile private var currentFeedRate: Int = 500
     private var machinePosition = Position()
     private var workspacePosition = Position()
     private var workCoordinateOffset = Position()
     private var currentWorkspace = "G54"
-    private var isConnected = false
+    @Volatile private var isConnected = false
 
     // Continuous jog (hold-to-move)
     private val jogHandler = Handler(Looper.getMainLooper())
@@ -110,7 +152,7 @@ class MainActivity : AppCompatActivity() {
     private val HEARTBEAT_INTERVAL_MS = 250L
     private val CONTINUOUS_TRAVEL_DISTANCE = 10000f  // 10 meters - jog cancel stops immediately anyway
     private val JOG_COOLDOWN_MS = 200L
-    private var jogCooldownUntil = 0L
+    @Volatile private var jogCooldownUntil = 0L
 
     // Dial step jog rate limiting - drop commands if sent too fast
     private val DIAL_MIN_SEND_INTERVAL_MS = 200L
@@ -123,19 +165,20 @@ class MainActivity : AppCompatActivity() {
     private val PREF_WORKSPACE = "cnc_pendant_workspace"
     private val PREF_DIAL_MODE = "cnc_pendant_dial_mode"
     private val PREF_DIAL_POINTS = "cnc_pendant_dial_points"
+    private val PREF_LATENCY_OVERLAY = "cnc_pendant_latency_overlay"
     private val gson = Gson()
     private var savedUrls: MutableList<String> = mutableListOf()
     private var scanJob: Job? = null
     private var isHoming = false
-    private var isHomed = false
+    @Volatile private var isHomed = false
     
     // Background timeout - disconnect after 30 minutes in background
     private val BACKGROUND_TIMEOUT_MS = 30L * 60L * 1000L  // 30 minutes
     private var backgroundDisconnectRunnable: Runnable? = null
-    private var homingCycle = 0
-    private var currentActiveState = ""
-    private var senderStatus = ""
-    private var senderConnected = false
+    @Volatile private var homingCycle = 0
+    @Volatile private var currentActiveState = ""
+    @Volatile private var senderStatus = ""
+    @Volatile private var senderConnected = false
     private var lockUiUpdatePending = false
     
     // Unlock sequence state
@@ -405,6 +448,7 @@ class MainActivity : AppCompatActivity() {
             isHomed = false
             homingCycle = 0
             currentActiveState = ""
+            usbEncoderManager?.setLedState("")
             senderStatus = ""
             senderConnected = false
         }
@@ -1487,6 +1531,7 @@ class MainActivity : AppCompatActivity() {
                 runOnUiThread {
                     Log.d("HomeButton", "State changed: '$state', isHoming=$isHoming, isConnected=$isConnected")
                     currentActiveState = state
+                    usbEncoderManager?.setLedState(state)
                     if (isHoming && (state.startsWith("Idle") || state.startsWith("Alarm"))) {
                         // Homing finished (machine returned to Idle) or failed (Alarm)
                         isHoming = false
@@ -1762,28 +1807,64 @@ class MainActivity : AppCompatActivity() {
                 
                 override fun onEncoderDisconnected() {
                     encoderConnected = false
+                    discardEncoderJog()
+                    logEncoderJogStats()
+                    Log.d(TAG, "Encoder dial: ${binding.jogDial.encoderFrameStats()}")
+                    binding.jogDial.resetEncoderFrameStats()
+                    usbEncoderManager?.inputHandler?.let { handler ->
+                        handler.post {
+                            jogPlanner.reset()
+                            logEncoderPlannerStats()
+                            // Unplugging says so itself; nothing left to announce
+                            jogDropNoticeRunnable?.let { handler.removeCallbacks(it) }
+                            jogDropNoticeRunnable = null
+                            jogDropNoticed = jogPlanner.distanceDropped
+                        }
+                    }
+                    usbEncoderManager?.latency?.let {
+                        if (it.enabled) Log.d(TAG, "Encoder input ${it.report()}")
+                    }
                     Log.d(TAG, "USB Encoder disconnected")
                     Toast.makeText(this@MainActivity, "USB Encoder disconnected", Toast.LENGTH_SHORT).show()
                 }
                 
-                override fun onEncoderRotation(delta: Int, position: Long) {
-                    handleEncoderRotation(delta, position)
+                // Input thread; jog traffic is decided there
+                override fun onEncoderRotation(delta: Int, count: Long, velocity: Float) {
+                    handleEncoderInput(delta, count, velocity)
                 }
                 
                 override fun onEncoderError(error: String) {
                     Log.e(TAG, "USB Encoder error: $error")
                 }
                 
+                // Button functions drive the UI, so they run on the main thread
                 override fun onButtonPressed(pin: Int) {
-                    handleButtonEvent(pin, true)
+                    runOnUiThread { handleButtonEvent(pin, true) }
                 }
                 
                 override fun onButtonReleased(pin: Int) {
-                    handleButtonEvent(pin, false)
+                    runOnUiThread { handleButtonEvent(pin, false) }
+                }
+                
+                override fun onButtonSnapshot(mask: Int, changed: Int, deviceMicros: Long) {
+                    runOnUiThread { handleButtonSnapshot(mask, changed) }
                 }
             })
             initialize()
         }
+        applyLatencyOverlay(loadLatencyOverlay())
+    }
+    
+    private fun handleButtonSnapshot(mask: Int, changed: Int) {
+        // Take the FN state from the same snapshot as the presses, so FN and a
+        // button pressed together always give the secondary function
+        val fnPins = ButtonConfigManager.getFnPinMask(this)
+        isFnHeld = (mask and fnPins) != 0
+        
+        for (pin in 0 until 32) {
+            if ((changed shr pin) and 1 == 0 || (fnPins shr pin) and 1 != 0) continue
+            handleButtonEvent(pin, (mask shr pin) and 1 != 0)
+        }
     }
     
     private fun handleButtonEvent(pin: Int, pressed: Boolean) {
@@ -2015,14 +2096,37 @@ class MainActivity : AppCompatActivity() {
         }
     }
     
-    private fun handleEncoderRotation(delta: Int, position: Long) {
+    /**
+     * Encoder input thread. Firmware that measures wheel speed drives the
+     * streaming planner right here, so a busy UI frame cannot delay jogs.
+     * Older firmware keeps the step and continuous jogs, which share state
+     * with the touch jogs, on the main thread. The dial takes the latest count
+     * once per display frame.
+     *
+     * @param count absolute encoder count
+     * @param velocity wheel speed in counts/s from the firmware's edge timestamps
+     *        (0 for a resync, whose speed is unknown), or NaN for older firmware
+     */
+    private fun handleEncoderInput(delta: Int, count: Long, velocity: Float) {
         // Firmware now reports actual clicks (not raw pulses), use directly
         if (delta == 0) return
         
         // Sync the on-screen dial to the encoder's absolute position
         // This prevents visual drift from floating-point accumulation errors
-        binding.jogDial.syncToEncoderPosition(position)
+        binding.jogDial.postEncoderPosition(count, usbEncoderManager?.countsPerRev ?: 100, velocity)
         
+        if (velocity.isNaN()) {
+            jogHandler.post { handleEncoderRotation(delta) }
+        } else {
+            streamEncoderJog(delta, velocity)
+        }
+    }
+    
+    /**
+     * Step and continuous jogs for firmware without wheel speed (main thread);
+     * the wheel's pace comes from message arrival times.
+     */
+    private fun handleEncoderRotation(delta: Int) {
         // Only send jog commands if connected and axis selected
         if (!isConnected || jogDisabled() || selectedAxis.isEmpty()) {
             return
@@ -2040,7 +2144,7 @@ class MainActivity : AppCompatActivity() {
         encoderIdleRunnable?.let { jogHandler.removeCallbacks(it) }
         
         // Check if we should reset tick count (timeout or direction change)
-        if (now - encoderLastTickTime > ENCODER_TICK_TIMEOUT_MS || 
+        if (now - encoderLastTickTime > ENCODER_TICK_TIMEOUT_MS ||
             (encoderTickCount > 0 && direction != encoderContinuousDirection)) {
             // Direction changed or too long since last tick - reset
             if (encoderContinuousJogging) {
@@ -2073,24 +2177,202 @@ class MainActivity : AppCompatActivity() {
             // Cancel any pending round-to-whole from previous jog
             roundToWholeRunnable?.let { jogHandler.removeCallbacks(it) }
             roundToWholeRunnable = null
-            // Start continuous jog
+            // Start continuous jog; it covers any clicks still queued
+            discardEncoderJog()
             encoderContinuousJogging = true
             startContinuousJog(selectedAxis, direction)
             return
         }
         
-        // Normal step jog mode - rate limited
-        if (now - lastEncoderJogSentAt < ENCODER_MIN_SEND_INTERVAL_MS || isJogCoolingDown()) {
+        // Normal step jog mode - rate limited; clicks inside the window wait
+        // in the accumulator instead of being dropped
+        encoderClicksReceived += absClicks
+        queueEncoderClicks(delta)
+        flushEncoderJog()
+    }
+    
+    // Encoder input thread
+    private fun streamEncoderJog(delta: Int, velocity: Float) {
+        if (!isConnected || jogDisabled() || selectedAxis.isEmpty()) return
+        if (jogPlannerAxis != selectedAxis) {
+            jogPlanner.reset()
+            jogPlannerAxis = selectedAxis
+        }
+        jogPlanner.addClicks(delta, currentStep, velocity, currentFeedRate, System.currentTimeMillis())
+        pumpJogPlanner()
+        noticeJogPlannerDrops()
+    }
+    
+    /** Send the planner's segments while GRBL has room, then check again shortly */
+    private fun pumpJogPlanner() {
+        val handler = usbEncoderManager?.inputHandler ?: return
+        jogPlannerRunnable?.let { handler.removeCallbacks(it) }
+        jogPlannerRunnable = null
+        if (!jogPlanner.hasPending) return
+        
+        if (!isConnected || jogDisabled() || selectedAxis != jogPlannerAxis) {
+            jogPlanner.reset()
+            noticeJogPlannerDrops()
             return
         }
         
-        lastEncoderJogSentAt = now
+        val now = System.currentTimeMillis()
+        if (!isJogCoolingDown()) {
+            while (true) {
+                val segment = jogPlanner.poll(now) ?: break
+                sendEncoderJogCommand(jogPlannerAxis, segment.distance, segment.feed)
+                // Feedback at the step jog rate, not per segment
+                if (now - plannerClickAt >= ENCODER_MIN_SEND_INTERVAL_MS) {
+                    plannerClickAt = now
+                    playClick()
+                }
+            }
+        }
         
-        // Convert encoder clicks to jog distance (use reported delta for smooth movement)
-        val distance = currentStep * absClicks * direction
+        if (jogPlanner.hasPending) {
+            jogPlannerRunnable = Runnable {
+                jogPlannerRunnable = null
+                pumpJogPlanner()
+            }
+            handler.postDelayed(jogPlannerRunnable!!, JOG_PLANNER_TICK_MS)
+        }
+    }
+    
+    /**
+     * Tell the operator about travel the planner dropped since the last
+     * notice, on the main thread; a notice due inside the interval waits
+     * for its end (encoder input thread).
+     */
+    private fun noticeJogPlannerDrops() {
+        val handler = usbEncoderManager?.inputHandler ?: return
+        if (jogDropNoticeRunnable != null) return
+        val dropped = jogPlanner.distanceDropped - jogDropNoticed
+        if (dropped < JOG_DROP_MIN_NOTICE_MM) return
+        
+        val now = System.currentTimeMillis()
+        val wait = jogDropNoticeAt + JOG_DROP_NOTICE_INTERVAL_MS - now
+        if (wait > 0) {
+            jogDropNoticeRunnable = Runnable {
+                jogDropNoticeRunnable = null
+                noticeJogPlannerDrops()
+            }
+            handler.postDelayed(jogDropNoticeRunnable!!, wait)
+            return
+        }
+        jogDropNoticeAt = now
+        jogDropNoticed = jogPlanner.distanceDropped
+        jogHandler.post { warnJogDropped(dropped) }
+    }
+    
+    private fun warnJogDropped(distanceMm: Double) {
+        val amount = if (unitsPreference == "metric") {
+            String.format("%.1f mm", distanceMm)
+        } else {
+            String.format("%.3f in", distanceMm / 25.4)
+        }
+        Toast.makeText(this, "Wheel travel not jogged: $amount", Toast.LENGTH_SHORT).show()
+        vibrator?.let {
+            if (android.os.Build.VERSION.SDK_INT >= android.os.Build.VERSION_CODES.O) {
+                it.vibrate(VibrationEffect.createOneShot(80, VibrationEffect.DEFAULT_AMPLITUDE))
+            } else {
+                @Suppress("DEPRECATION")
+                it.vibrate(80)
+            }
+        }
+    }
+    
+    private fun queueEncoderClicks(delta: Int) {
+        if (encoderPendingClicks != 0 && encoderPendingAxis != selectedAxis) {
+            discardEncoderJog()
+        }
+        encoderPendingAxis = selectedAxis
+        
+        // Keep the queued distance within the bound in machine units, so the
+        // cap does not grow with the step size
+        val step = currentStep
+        val limit = maxOf(ENCODER_MAX_PENDING_DISTANCE_MM, step)
+        val maxForward = kotlin.math.floor((limit - encoderPendingDistance) / step + 1e-4f).toInt()
+        val maxBack = kotlin.math.floor((limit + encoderPendingDistance) / step + 1e-4f).toInt()
+        val accepted = delta.coerceIn(minOf(0, -maxBack), maxOf(0, maxForward))
+        encoderClicksDropped += kotlin.math.abs(delta - accepted)
+        if (accepted * encoderPendingClicks < 0) {
+            encoderClicksCancelled += 2L * minOf(kotlin.math.abs(accepted), kotlin.math.abs(encoderPendingClicks))
+        }
+        encoderPendingClicks += accepted
+        encoderPendingDistance = if (encoderPendingClicks == 0) 0f else encoderPendingDistance + step * accepted
+    }
+    
+    /**
+     * Send the queued clicks as one jog if the send interval and jog cooldown
+     * allow it, otherwise try again when they will.
+     */
+    private fun flushEncoderJog() {
+        encoderFlushRunnable?.let { jogHandler.removeCallbacks(it) }
+        encoderFlushRunnable = null
+        if (encoderPendingClicks == 0) return
+        
+        // Conditions may have changed while the clicks waited
+        if (!isConnected || jogDisabled() || encoderContinuousJogging || selectedAxis != encoderPendingAxis) {
+            discardEncoderJog()
+            return
+        }
+        
+        val now = System.currentTimeMillis()
+        val wait = maxOf(lastEncoderJogSentAt + ENCODER_MIN_SEND_INTERVAL_MS - now, jogCooldownUntil - now)
+        if (wait > 0) {
+            encoderFlushRunnable = Runnable {
+                encoderFlushRunnable = null
+                flushEncoderJog()
+            }
+            jogHandler.postDelayed(encoderFlushRunnable!!, wait)
+            return
+        }
+        
+        lastEncoderJogSentAt = now
+        val distance = encoderPendingDistance
+        encoderClicksCommanded += kotlin.math.abs(encoderPendingClicks)
+        encoderDistanceCommanded += kotlin.math.abs(distance)
+        encoderJogsSent++
+        encoderPendingClicks = 0
+        encoderPendingDistance = 0f
         
         playClick()
-        webSocketManager.sendJogCommand(selectedAxis, distance, currentFeedRate)
+        sendEncoderJogCommand(encoderPendingAxis, distance, currentFeedRate)
+    }
+    
+    // Jogs driven by the wheel, always in mm; timed for the latency monitor while it is on
+    private fun sendEncoderJogCommand(axis: String, distance: Float, feedRate: Int) {
+        val latency = usbEncoderManager?.latency
+        if (latency == null || !latency.enabled) {
+            webSocketManager.sendJogCommand(axis, distance, feedRate, millimetres = true)
+            return
+        }
+        val start = System.nanoTime()
+        webSocketManager.sendJogCommand(axis, distance, feedRate, millimetres = true)
+        latency.jogSent(start, System.nanoTime())
+    }
+    
+    private fun discardEncoderJog() {
+        encoderFlushRunnable?.let { jogHandler.removeCallbacks(it) }
+        encoderFlushRunnable = null
+        encoderClicksDropped += kotlin.math.abs(encoderPendingClicks)
+        encoderPendingClicks = 0
+        encoderPendingDistance = 0f
+    }
+    
+    private fun logEncoderJogStats() {
+        Log.d(TAG, "Encoder step jogs: $encoderClicksReceived clicks received, " +
+            "$encoderClicksCommanded commanded in $encoderJogsSent jogs " +
+            "(${String.format("%.3f", encoderDistanceCommanded)} total), $encoderClicksDropped dropped, " +
+            "$encoderClicksCancelled cancelled by reversals")
+    }
+    
+    // Encoder input thread
+    private fun logEncoderPlannerStats() {
+        Log.d(TAG, "Encoder jog planner: ${jogPlanner.segmentsSent} segments, " +
+            "${String.format("%.3f", jogPlanner.distanceSent)} sent, " +
+            "${String.format("%.3f", jogPlanner.distanceDropped)} dropped")
+        Log.d(TAG, "Encoder event queue: ${usbEncoderManager?.eventQueueStats()}")
     }
     
     private fun stopEncoderContinuousJog() {
@@ -2150,6 +2432,11 @@ class MainActivity : AppCompatActivity() {
         // Cancel any pending round-to-whole
         roundToWholeRunnable?.let { jogHandler.removeCallbacks(it) }
         roundToWholeRunnable = null
+        latencyOverlayRunnable?.let { jogHandler.removeCallbacks(it) }
+        latencyOverlayRunnable = null
+        // Drop queued encoder clicks; releasing the encoder manager stops
+        // the input thread and the planner with it
+        discardEncoderJog()
         webSocketManager.disconnect()
         usbEncoderManager?.release()
         usbEncoderManager = null
@@ -2292,6 +2579,62 @@ class MainActivity : AppCompatActivity() {
             .apply()
     }
 
+    // --- Latency Diagnostics ---
+
+    private fun loadLatencyOverlay(): Boolean {
+        val prefs = getSharedPreferences("prefs", MODE_PRIVATE)
+        return prefs.getBoolean(PREF_LATENCY_OVERLAY, false)
+    }
+
+    private fun saveLatencyOverlay(show: Boolean) {
+        getSharedPreferences("prefs", MODE_PRIVATE).edit()
+            .putBoolean(PREF_LATENCY_OVERLAY, show)
+            .apply()
+    }
+
+    /** Show or hide the overlay; tap it to clear the histograms, long-press to share them */
+    private fun applyLatencyOverlay(show: Boolean) {
+        usbEncoderManager?.setLatencyTracking(show)
+        latencyOverlayRunnable?.let { jogHandler.removeCallbacks(it) }
+        latencyOverlayRunnable = null
+        
+        val overlay = binding.latencyOverlay
+        overlay.visibility = if (show) View.VISIBLE else View.GONE
+        if (!show) {
+            overlay.setOnClickListener(null)
+            overlay.setOnLongClickListener(null)
+            overlay.isClickable = false
+            overlay.isLongClickable = false
+            return
+        }
+        overlay.setOnClickListener { usbEncoderManager?.latency?.reset() }
+        overlay.setOnLongClickListener {
+            exportLatencyReport()
+            true
+        }
+        latencyOverlayRunnable = object : Runnable {
+            override fun run() {
+                overlay.text = usbEncoderManager?.latency?.report()?.trimEnd() ?: ""
+                jogHandler.postDelayed(this, LATENCY_OVERLAY_REFRESH_MS)
+            }
+        }
+        jogHandler.post(latencyOverlayRunnable!!)
+    }
+
+    private fun exportLatencyReport() {
+        val latency = usbEncoderManager?.latency ?: return
+        if (!latency.enabled) {
+            Toast.makeText(this, "Turn on the latency overlay first", Toast.LENGTH_SHORT).show()
+            return
+        }
+        val intent = Intent(Intent.ACTION_SEND).apply {
+            type = "text/plain"
+            putExtra(Intent.EXTRA_SUBJECT, "ncSender Control encoder latency")
+            putExtra(Intent.EXTRA_TEXT, latency.report())
+        }
+        startActivity(Intent.createChooser(intent, "Export latency report"))
+    }
+
     // --- About Dialog ---
 
     private fun showAboutDialog() {
@@ -2326,6 +2669,8 @@ class MainActivity : AppCompatActivity() {
         val configureButtonsBtn = dialogView.findViewById<Button>(R.id.configureButtonsBtn)
         val firmwareInfoLabel = dialogView.findViewById<TextView>(R.id.firmwareInfoLabel)
         val flashFirmwareBtn = dialogView.findViewById<Button>(R.id.flashFirmwareBtn)
+        val latencyOverlaySwitch = dialogView.findViewById<SwitchMaterial>(R.id.latencyOverlaySwitch)
+        val exportLatencyBtn = dialogView.findViewById<Button>(R.id.exportLatencyBtn)
 
         // Set up dial points options
         val dialPointsOptions = arrayOf("50 points", "100 points")
@@ -2365,6 +2710,9 @@ class MainActivity : AppCompatActivity() {
             startFirmwareFlash(selectedBoardType)
         }
 
+        latencyOverlaySwitch.isChecked = loadLatencyOverlay()
+        exportLatencyBtn.setOnClickListener { exportLatencyReport() }
+
         // Set up number of buttons options (0-12)
         val buttonOptions = (0..12).map { if (it == 0) "None" else it.toString() }.toTypedArray()
         val buttonAdapter = ArrayAdapter(this, R.layout.spinner_item_dark, buttonOptions)
@@ -2413,6 +2761,9 @@ class MainActivity : AppCompatActivity() {
 
                 // Send button config to encoder device
                 sendButtonConfigToEncoder()
+
+                saveLatencyOverlay(latencyOverlaySwitch.isChecked)
+                applyLatencyOverlay(latencyOverlaySwitch.isChecked)
             }
             .setNegativeButton("Cancel", null)
             .show()
@@ -10,7 +10,10 @@ import android.hardware.usb.UsbDeviceConnection
 import android.hardware.usb.UsbManager
 import android.os.Build
 import android.os.Handler
+import android.os.HandlerThread
 import android.os.Looper
+import android.os.Process
+import android.os.SystemClock
 import android.util.Log
 import com.hoho.android.usbserial.driver.CdcAcmSerialDriver
 import com.hoho.android.usbserial.driver.ProbeTable
@@ -25,6 +28,10 @@ import java.util.concurrent.Executors
 /**
  * Manages USB serial connection to an RP2040 encoder device.
  * Receives encoder rotation data and converts to jog commands.
+ *
+ * Encoder, button and chord events are handed through a bounded
+ * [EncoderEventQueue] to a dedicated input thread, so a slow UI frame does
+ * not hold up jog traffic; see [EncoderListener] for which callbacks run where.
  */
 class UsbEncoderManager(private val context: Context) : SerialInputOutputManager.Listener {
 
@@ -51,24 +58,82 @@ class UsbEncoderManager(private val context: Context) : SerialInputOutputManager
         private const val DATA_BITS = 8
         private const val STOP_BITS = UsbSerialPort.STOPBITS_1
         private const val PARITY = UsbSerialPort.PARITY_NONE
+        
+        private const val DEFAULT_COUNTS_PER_REV = 100
+        
+        // Minimum time between resend requests for the same gap; the
+        // firmware replays everything from the requested event onwards
+        private const val RESEND_RETRY_MS = 250L
+        
+        // Clock sync pings while latency tracking is on
+        private const val LATENCY_PING_MS = 2000L
     }
 
+    /**
+     * Connection callbacks run on the main thread. Rotation, button and chord
+     * callbacks run on the encoder input thread ([inputHandler]), in the order
+     * the device sent them; post anything that touches views to the main thread.
+     */
     interface EncoderListener {
         fun onEncoderConnected()
         fun onEncoderDisconnected()
-        fun onEncoderRotation(delta: Int, position: Long)
+        /**
+         * @param count absolute encoder count (64-bit, never wraps); the dial
+         *        angle is count mod [countsPerRev]. Older firmware reports only
+         *        its 0-99 position, which is passed here instead.
+         * @param velocity wheel speed in counts/s measured by the firmware, 0 for
+         *        a resync (speed unknown), NaN if the firmware does not report it
+         */
+        fun onEncoderRotation(delta: Int, count: Long, velocity: Float)
         fun onEncoderError(error: String)
         fun onButtonPressed(pin: Int)
         fun onButtonReleased(pin: Int)
+
+        /**
+         * All buttons at once, sent by the firmware in snapshot mode whenever any
+         * of them changes. Bit n is GPIO n; [changed] marks the pins that differ
+         * from the previous snapshot. Defaults to one press/release per changed pin.
+         */
+        fun onButtonSnapshot(mask: Int, changed: Int, deviceMicros: Long) {
+            for (pin in 0 until 32) {
+                if ((changed shr pin) and 1 == 0) continue
+                if ((mask shr pin) and 1 != 0) onButtonPressed(pin) else onButtonReleased(pin)
+            }
+        }
+
+        /** A firmware-side chord (see [sendChords]) became complete or broke */
+        fun onChord(id: Int, pressed: Boolean) {}
     }
 
-    private var listener: EncoderListener? = null
+    @Volatile private var listener: EncoderListener? = null
     private var usbManager: UsbManager? = null
     private var usbSerialPort: UsbSerialPort? = null
     private var usbConnection: UsbDeviceConnection? = null
     private var serialIoManager: SerialInputOutputManager? = null
     private val mainHandler = Handler(Looper.getMainLooper())
     
+    // Input thread: consumes the event queue. Listeners may schedule their own
+    // timers on inputHandler to keep all jog state on this one thread.
+    private val inputThread = HandlerThread("EncoderInput", Process.THREAD_PRIORITY_URGENT_DISPLAY).apply { start() }
+    val inputHandler = Handler(inputThread.looper)
+    private val drainEvents = Runnable { deliverQueuedEvents() }
+    private val eventQueue = EncoderEventQueue { inputHandler.post(drainEvents) }
+    
+    // Input latency per stage, off until setLatencyTracking(true)
+    val latency = LatencyMonitor()
+    private val latencyPing = object : Runnable {
+        override fun run() {
+            if (!latency.enabled) return
+            if (isConnected) {
+                latency.pingSent(System.nanoTime())
+                sendCommand(JSONObject().put("type", "ping"))
+            }
+            inputHandler.postDelayed(this, LATENCY_PING_MS)
+        }
+    }
+    // When the serial reader got the chunk being parsed
+    private var receivedAt = 0L
+    
     // Custom prober that includes RP2040 CDC devices
     private val customProber: UsbSerialProber by lazy {
         val probeTable = ProbeTable()
@@ -79,11 +144,76 @@ class UsbEncoderManager(private val context: Context) : SerialInputOutputManager
         UsbSerialProber(probeTable)
     }
     
-    // Buffer for incoming serial data
-    private val readBuffer = StringBuilder()
+    // JSON lines: the frequent messages are decoded in place without allocating
+    private val lineParser = EncoderStreamParser(object : EncoderStreamParser.Sink {
+        override fun onEvent(event: EncoderStreamParser.Event) = dispatchStreamEvent(event)
+        override fun onOtherLine(line: ByteArray, length: Int) {
+            processMessage(String(line, 0, length, Charsets.ISO_8859_1))
+        }
+    })
+    
+    // Binary protocol (opt-in, see BinaryProtocol). Switched by the firmware's
+    // "protocol" acknowledgement, which marks the exact point in the stream
+    // where the format changes.
+    var preferBinaryProtocol = true
+    @Volatile private var binaryMode = false
+    private val frameBuffer = ByteArray(BinaryProtocol.MAX_FRAME_SIZE)
+    private val recordBuffer = ByteArray(BinaryProtocol.MAX_FRAME_SIZE)
+    private var frameLength = 0
+    private var frameOverflow = false
+    var binaryFrameErrors = 0L
+        private set
+    
+    // Ask for one button snapshot per change instead of per-pin messages,
+    // when the firmware supports it
+    var preferButtonSnapshots = true
+    
+    // Move encoder and button events to the firmware's HID endpoint (HID
+    // builds only); commands and replies stay on the serial port
+    var preferHidTransport = true
+    private var hidReader: HidReportReader? = null
+    private var connectedDevice: UsbDevice? = null
+    // HID reader thread only (reset before the reader starts)
+    private var hidLastSequence = -1
+    private var hidLastButtons = 0
+    private var hidLastCount = 0
+    private var hidCount = 0L
+    var hidMissedReports = 0L
+        private set
+    
+    // Encoder counts per revolution (detents x decode), from the ready and
+    // resolution messages. Firmware without them is a fixed 100 PPR.
+    @Volatile var countsPerRev = DEFAULT_COUNTS_PER_REV
+        private set
+    
+    // Event sequence numbers (serial reader thread). Events are dropped until
+    // the ready message gives a baseline, so ones buffered by the firmware
+    // before this session cannot move the machine. A gap asks the firmware
+    // to replay from the first missing event; it answers with the events or,
+    // if they are gone, a resync carrying the current count and buttons.
+    private var lastEventSeq = -1L
+    private var resendRequestedAt = 0L
+    private var lastEventCount = 0L
+    private var eventCountKnown = false
+    private var lastButtonMask = 0
+    var eventGaps = 0L
+        private set
+    var resendRequests = 0L
+        private set
+    var duplicateEvents = 0L
+        private set
+    var resyncs = 0L
+        private set
+    
+    // JSON command types the firmware accepts, from its ready message
+    @Volatile private var deviceCommands: Set<String> = emptySet()
+    
+    // Machine state shown on the encoder LED; re-sent whenever the device
+    // announces itself, so it survives a replug or firmware reset
+    @Volatile private var ledState: String? = null
     
     // Track connection state
-    private var isConnected = false
+    @Volatile private var isConnected = false
     private var pendingDevice: UsbDevice? = null
 
     private val usbReceiver = object : BroadcastReceiver() {
@@ -160,6 +290,9 @@ class UsbEncoderManager(private val context: Context) : SerialInputOutputManager
         } catch (e: Exception) {
             // Receiver might not be registered
         }
+        eventQueue.close()
+        inputHandler.removeCallbacks(latencyPing)
+        inputThread.quitSafely()
     }
 
     fun scanForEncoder() {
@@ -274,6 +407,7 @@ class UsbEncoderManager(private val context: Context) : SerialInputOutputManager
                 mainHandler.post { listener?.onEncoderError("Failed to open USB connection") }
                 return
             }
+            connectedDevice = device
             
             Log.d(TAG, "USB connection opened, driver has ${driver.ports.size} port(s)")
             
@@ -299,8 +433,10 @@ class UsbEncoderManager(private val context: Context) : SerialInputOutputManager
                 listener?.onEncoderConnected()
             }
             
-            // Send a ping to verify communication
+            // Send a ping to verify communication, and ask for the ready
+            // message again to learn the firmware's capabilities
             sendCommand(JSONObject().put("type", "ping"))
+            sendCommand(JSONObject().put("type", "hello"))
             
         } catch (e: Exception) {
             Log.e(TAG, "Error connecting to device", e)
@@ -311,10 +447,23 @@ class UsbEncoderManager(private val context: Context) : SerialInputOutputManager
 
     fun disconnect() {
         isConnected = false
+        binaryMode = false
+        deviceCommands = emptySet()
+        countsPerRev = DEFAULT_COUNTS_PER_REV
+        lastEventSeq = -1
+        eventCountKnown = false
+        resendRequestedAt = 0
+        latency.resetClock()
         
         serialIoManager?.listener = null
         serialIoManager?.stop()
         serialIoManager = null
+        lineParser.reset()
+        eventQueue.clear()
+        
+        hidReader?.stop()
+        hidReader = null
+        connectedDevice = null
         
         try {
             usbSerialPort?.close()
@@ -369,6 +518,65 @@ class UsbEncoderManager(private val context: Context) : SerialInputOutputManager
         })
     }
 
+    /**
+     * Set the encoder resolution: [ppr] detents per revolution and [decode]
+     * counts per detent (1, 2 or 4). The firmware replies with the values it
+     * applied, which update [countsPerRev].
+     */
+    fun setResolution(ppr: Int, decode: Int) {
+        sendCommand(JSONObject().apply {
+            put("type", "resolution")
+            put("ppr", ppr)
+            put("decode", decode)
+        })
+    }
+
+    /**
+     * Switch the [latency] histograms on or off. While on, the device is pinged
+     * every few seconds to keep its clock offset current.
+     */
+    fun setLatencyTracking(enabled: Boolean) {
+        latency.enabled = enabled
+        inputHandler.removeCallbacks(latencyPing)
+        if (enabled) inputHandler.post(latencyPing)
+    }
+
+    /**
+     * Whether the connected firmware listed this command type in its ready message
+     */
+    fun supportsCommand(type: String): Boolean = type in deviceCommands
+
+    /**
+     * Show the machine state (GRBL state name such as "Idle" or "Hold:0") as
+     * the encoder LED's background colour. Ignored by firmware without the
+     * led command; an empty or unknown state turns the background off.
+     */
+    fun setLedState(state: String) {
+        ledState = state
+        if (supportsCommand("led")) {
+            sendLedState(state)
+        }
+    }
+
+    private fun sendLedState(state: String) {
+        sendCommand(JSONObject().apply {
+            put("type", "led")
+            put("state", state)
+        })
+    }
+
+    /**
+     * Define firmware-side chords; each entry is a set of pins reported as one
+     * chord event (by index) once all of them are held
+     */
+    fun sendChords(chords: List<List<Int>>) {
+        Log.d(TAG, "Sending chords: $chords")
+        sendCommand(JSONObject().apply {
+            put("type", "chords")
+            put("chords", org.json.JSONArray(chords.map { org.json.JSONArray(it) }))
+        })
+    }
+
     /**
      * Clear all button configurations on the encoder device
      */
@@ -381,21 +589,276 @@ class UsbEncoderManager(private val context: Context) : SerialInputOutputManager
 
     // SerialInputOutputManager.Listener implementation
     override fun onNewData(data: ByteArray) {
-        // Append to buffer and process complete lines
-        val text = String(data)
-        readBuffer.append(text)
-        
-        // Process complete JSON lines
-        var newlineIndex: Int
-        while (readBuffer.indexOf("\n").also { newlineIndex = it } >= 0) {
-            val line = readBuffer.substring(0, newlineIndex).trim()
-            readBuffer.delete(0, newlineIndex + 1)
-            
-            if (line.isNotEmpty()) {
-                processMessage(line)
+        receivedAt = System.nanoTime()
+        // Byte by byte, because a protocol switch can land mid-chunk
+        for (b in data) {
+            if (binaryMode) {
+                acceptFrameByte(b)
+            } else {
+                lineParser.accept(b)
+            }
+        }
+    }
+    
+    private fun acceptFrameByte(b: Byte) {
+        if (b.toInt() != 0) {
+            if (frameLength < frameBuffer.size) {
+                frameBuffer[frameLength++] = b
+            } else {
+                frameOverflow = true
+            }
+            return
+        }
+        
+        // Delimiter: decode whatever was collected since the last one
+        if (frameLength > 0 && !frameOverflow) {
+            processFrame(frameLength)
+        } else if (frameOverflow) {
+            binaryFrameErrors++
+        }
+        frameLength = 0
+        frameOverflow = false
+    }
+    
+    private fun processFrame(length: Int) {
+        val decoded = BinaryProtocol.cobsDecode(frameBuffer, length, recordBuffer)
+        val recordLength = if (decoded > 0) BinaryProtocol.checkRecord(recordBuffer, decoded) else -1
+        if (recordLength < 1) {
+            binaryFrameErrors++
+            Log.w(TAG, "Dropped corrupt binary frame ($length bytes)")
+            return
+        }
+        
+        val record = recordBuffer
+        when (record[0].toInt() and 0xFF) {
+            BinaryProtocol.REC_ENCODER -> if (recordLength >= BinaryProtocol.REC_ENCODER_SIZE &&
+                acceptSeq(BinaryProtocol.le32(record, 25).toLong() and 0xFFFFFFFFL)) {
+                val delta = BinaryProtocol.le16(record, 1).toShort().toInt()
+                val velocity = BinaryProtocol.le16(record, 7).toShort() / 10f
+                dispatchEncoder(delta, BinaryProtocol.le64(record, 9), velocity, receivedAt,
+                    BinaryProtocol.le32(record, 17).toLong() and 0xFFFFFFFFL,
+                    BinaryProtocol.le32(record, 21).toLong() and 0xFFFFFFFFL)
+            }
+            BinaryProtocol.REC_BUTTON -> if (recordLength >= BinaryProtocol.REC_BUTTON_SIZE &&
+                acceptSeq(BinaryProtocol.le32(record, 3).toLong() and 0xFFFFFFFFL)) {
+                dispatchButton(record[1].toInt() and 0xFF, record[2].toInt() != 0)
+            }
+            BinaryProtocol.REC_BUTTON_STATE -> if (recordLength >= BinaryProtocol.REC_BUTTON_STATE_SIZE &&
+                acceptSeq(BinaryProtocol.le32(record, 13).toLong() and 0xFFFFFFFFL)) {
+                dispatchButtonSnapshot(
+                    BinaryProtocol.le32(record, 1),
+                    BinaryProtocol.le32(record, 5),
+                    BinaryProtocol.le32(record, 9).toLong() and 0xFFFFFFFFL
+                )
+            }
+            BinaryProtocol.REC_CHORD -> if (recordLength >= BinaryProtocol.REC_CHORD_SIZE &&
+                acceptSeq(BinaryProtocol.le32(record, 7).toLong() and 0xFFFFFFFFL)) {
+                dispatchChord(record[1].toInt() and 0xFF, record[2].toInt() != 0)
+            }
+            BinaryProtocol.REC_HEARTBEAT -> if (recordLength >= BinaryProtocol.REC_HEARTBEAT_SIZE) {
+                checkHeartbeatSeq(BinaryProtocol.le32(record, 14).toLong() and 0xFFFFFFFFL)
+            }
+            BinaryProtocol.REC_PONG -> if (recordLength >= BinaryProtocol.REC_PONG_SIZE) {
+                latency.pongReceived(BinaryProtocol.le32(record, 13).toLong() and 0xFFFFFFFFL, receivedAt)
+                Log.d(TAG, "Received pong, count: ${BinaryProtocol.le64(record, 5)}")
+            }
+            BinaryProtocol.REC_TEXT -> {
+                processMessage(String(record, 1, recordLength - 1, Charsets.US_ASCII))
+            }
+            else -> Log.w(TAG, "Unknown binary record type ${record[0]}")
+        }
+    }
+    
+    private fun dispatchStreamEvent(event: EncoderStreamParser.Event) {
+        if (event.kind != EncoderStreamParser.KIND_PONG && event.kind != EncoderStreamParser.KIND_HEARTBEAT &&
+            !acceptSeq(event.seq)) return
+        when (event.kind) {
+            EncoderStreamParser.KIND_ENCODER ->
+                dispatchEncoder(event.delta, event.count, event.velocity, receivedAt, event.micros, event.txMicros)
+            EncoderStreamParser.KIND_BUTTON -> dispatchButton(event.pin, event.pressed)
+            EncoderStreamParser.KIND_BUTTON_STATE -> dispatchButtonSnapshot(event.mask, event.changed, event.micros)
+            EncoderStreamParser.KIND_CHORD -> dispatchChord(event.id, event.pressed)
+            EncoderStreamParser.KIND_PONG -> {
+                latency.pongReceived(event.micros, receivedAt)
+                Log.d(TAG, "Received pong, count: ${event.count}")
+            }
+            EncoderStreamParser.KIND_HEARTBEAT -> checkHeartbeatSeq(event.seq)
+        }
+    }
+    
+    /**
+     * Check an event's sequence number against the last one accepted.
+     * @return false if the event is a duplicate, follows a gap or arrives
+     *         before the ready baseline, and must not be dispatched
+     */
+    private fun acceptSeq(seq: Long): Boolean {
+        if (seq < 0) return true            // Firmware without sequence numbers
+        val last = lastEventSeq
+        if (last < 0) return false
+        if (seq <= last) {
+            duplicateEvents++
+            return false
+        }
+        if (seq > last + 1) {
+            onEventGap()
+            return false
+        }
+        lastEventSeq = seq
+        return true
+    }
+    
+    // The heartbeat names the last event the firmware wrote; one we never
+    // saw means the tail of the stream was lost
+    private fun checkHeartbeatSeq(seq: Long) {
+        if (lastEventSeq >= 0 && seq > lastEventSeq) onEventGap()
+    }
+    
+    private fun onEventGap() {
+        val now = SystemClock.uptimeMillis()
+        if (resendRequestedAt != 0L && now - resendRequestedAt < RESEND_RETRY_MS) return
+        resendRequestedAt = now
+        eventGaps++
+        resendRequests++
+        Log.w(TAG, "Encoder event gap after seq $lastEventSeq, requesting resend")
+        sendCommand(JSONObject().apply {
+            put("type", "resend")
+            put("from", lastEventSeq + 1)
+        })
+    }
+    
+    // Apply what the events lost between lastEventSeq and seq would have
+    private fun applyResync(seq: Long, count: Long, buttons: Int) {
+        resyncs++
+        resendRequestedAt = 0
+        lastEventSeq = seq
+        Log.w(TAG, "Encoder events lost, resynchronised at seq $seq")
+        // Without an earlier count the lost rotation is unknown; only rebase
+        val delta = count - lastEventCount
+        // Speed unknown: 0, as for a first click from rest, so the jump goes
+        // to the jog planner with this firmware's other events
+        if (eventCountKnown && delta in Int.MIN_VALUE..Int.MAX_VALUE) {
+            dispatchEncoder(delta.toInt(), count, 0f, receivedAt)
+        } else {
+            lastEventCount = count
+            eventCountKnown = true
+        }
+        dispatchButtonSnapshot(buttons, buttons xor lastButtonMask, 0)
+    }
+    
+    // Called on the HID reader thread
+    private fun processHidReport(report: ByteArray) {
+        val sequence = HidReport.sequence(report)
+        if (hidLastSequence >= 0) {
+            val missed = (sequence - hidLastSequence - 1) and 0xFF
+            if (missed != 0) hidMissedReports += missed
+        }
+        hidLastSequence = sequence
+        
+        // The report carries the low 32 bits of the count; extend them
+        val count = HidReport.count(report)
+        hidCount += count - hidLastCount
+        hidLastCount = count
+        queueEncoder(HidReport.delta(report), hidCount, HidReport.velocity(report), System.nanoTime())
+        
+        if ((HidReport.flags(report) and HidReport.FLAG_BUTTONS_CHANGED) != 0) {
+            val mask = HidReport.buttons(report)
+            queueButtonSnapshot(mask, mask xor hidLastButtons, 0)
+            hidLastButtons = mask
+        }
+    }
+    
+    private fun startHidTransport() {
+        val connection = usbConnection ?: return
+        val device = connectedDevice ?: return
+        
+        // A repeated ready (device reset) only needs the command again
+        if (hidReader == null) {
+            val reader = HidReportReader(connection) { processHidReport(it) }
+            hidLastSequence = -1
+            hidLastButtons = 0
+            hidLastCount = 0
+            hidCount = 0
+            if (!reader.start(device)) {
+                Log.d(TAG, "No usable HID interface, keeping events on serial")
+                return
+            }
+            hidReader = reader
+        }
+        sendCommand(JSONObject().apply {
+            put("type", "transport")
+            put("events", "hid")
+        })
+    }
+    
+    // The dispatch* functions run on the serial reader thread and keep the
+    // count and button mask a resync is applied against. The HID reader
+    // keeps its own (hidCount, hidLastButtons) and only uses the queue*
+    // functions, so each thread owns its state.
+    private fun dispatchEncoder(
+        delta: Int, count: Long, velocity: Float, receivedNs: Long,
+        edgeMicros: Long = -1, txMicros: Long = -1
+    ) {
+        lastEventCount = count
+        eventCountKnown = true
+        queueEncoder(delta, count, velocity, receivedNs, edgeMicros, txMicros)
+    }
+    
+    // Any reader thread
+    private fun queueEncoder(
+        delta: Int, count: Long, velocity: Float, receivedNs: Long,
+        edgeMicros: Long = -1, txMicros: Long = -1
+    ) {
+        if (delta != 0) {
+            eventQueue.putEncoder(delta, count, velocity, receivedNs, edgeMicros, txMicros)
+        }
+    }
+    
+    private fun dispatchButton(pin: Int, pressed: Boolean) {
+        if (pin in 0 until 32) {
+            lastButtonMask = if (pressed) lastButtonMask or (1 shl pin) else lastButtonMask and (1 shl pin).inv()
+        }
+        if (pin >= 0) {
+            eventQueue.putButton(pin, pressed)
+        }
+    }
+
+    private fun dispatchButtonSnapshot(mask: Int, changed: Int, deviceMicros: Long) {
+        lastButtonMask = mask
+        queueButtonSnapshot(mask, changed, deviceMicros)
+    }
+    
+    // Any reader thread
+    private fun queueButtonSnapshot(mask: Int, changed: Int, deviceMicros: Long) {
+        if (changed != 0) {
+            eventQueue.putButtonSnapshot(mask, changed, deviceMicros)
+        }
+    }
+    
+    private fun dispatchChord(id: Int, pressed: Boolean) {
+        eventQueue.putChord(id, pressed)
+    }
+    
+    // Input thread
+    private fun deliverQueuedEvents() {
+        while (true) {
+            val e = eventQueue.take() ?: break
+            val l = listener ?: continue
+            when (e.kind) {
+                EncoderEventQueue.KIND_ENCODER -> {
+                    if (latency.enabled) {
+                        latency.eventTaken(e.edgeMicros, e.txMicros, e.receivedAt, e.queuedAt, e.takenAt)
+                    }
+                    l.onEncoderRotation(e.delta, e.count, e.velocity)
+                }
+                EncoderEventQueue.KIND_BUTTON -> if (e.pressed) l.onButtonPressed(e.pin) else l.onButtonReleased(e.pin)
+                EncoderEventQueue.KIND_BUTTON_STATE -> l.onButtonSnapshot(e.mask, e.changed, e.micros)
+                EncoderEventQueue.KIND_CHORD -> l.onChord(e.pin, e.pressed)
             }
         }
     }
+    
+    /** Event queue wait summary; call on the input thread */
+    fun eventQueueStats(): String = eventQueue.waitStats()
 
     override fun onRunError(e: Exception) {
         Log.e(TAG, "Serial I/O error", e)
@@ -405,35 +868,51 @@ class UsbEncoderManager(private val context: Context) : SerialInputOutputManager
         }
     }
 
+    private fun updateCountsPerRev(json: JSONObject) {
+        val ppr = json.optInt("ppr", DEFAULT_COUNTS_PER_REV)
+        val decode = json.optInt("decode", 1)
+        countsPerRev = if (ppr > 0 && decode > 0) ppr * decode else DEFAULT_COUNTS_PER_REV
+    }
+
     private fun processMessage(line: String) {
         try {
             val json = JSONObject(line)
             val type = json.optString("type", "")
             
             when (type) {
-                "encoder" -> {
+                "encoder" -> if (acceptSeq(json.optLong("seq", -1))) {
                     val delta = json.optInt("delta", 0)
-                    val position = json.optLong("position", 0)
-                    
-                    if (delta != 0) {
-                        mainHandler.post {
-                            listener?.onEncoderRotation(delta, position)
-                        }
-                    }
+                    val count = json.optLong("count", json.optLong("position", 0))
+                    val velocity = json.optDouble("velocity", Double.NaN).toFloat()
+                    dispatchEncoder(delta, count, velocity, receivedAt, json.optLong("t", -1), json.optLong("tx", -1))
                 }
-                "button" -> {
+                "button" -> if (acceptSeq(json.optLong("seq", -1))) {
                     val pin = json.optInt("pin", -1)
-                    val state = json.optString("state", "")
-                    
-                    if (pin >= 0) {
-                        mainHandler.post {
-                            when (state) {
-                                "pressed" -> listener?.onButtonPressed(pin)
-                                "released" -> listener?.onButtonReleased(pin)
-                            }
-                        }
+                    when (json.optString("state", "")) {
+                        "pressed" -> dispatchButton(pin, true)
+                        "released" -> dispatchButton(pin, false)
                     }
                 }
+                "button_state" -> if (acceptSeq(json.optLong("seq", -1))) {
+                    dispatchButtonSnapshot(
+                        json.optLong("mask", 0).toInt(),
+                        json.optLong("changed", 0).toInt(),
+                        json.optLong("t", 0)
+                    )
+                }
+                "chord" -> if (acceptSeq(json.optLong("seq", -1))) {
+                    val id = json.optInt("id", -1)
+                    when (json.optString("state", "")) {
+                        "pressed" -> dispatchChord(id, true)
+                        "released" -> dispatchChord(id, false)
+                    }
+                }
+                "buttons_mode" -> {
+                    Log.d(TAG, "Button report mode: ${json.optString("mode")}")
+                }
+                "chords_configured" -> {
+                    Log.d(TAG, "Chords configured: ${json.optInt("count", 0)}")
+                }
                 "buttons_configured" -> {
                     val count = json.optInt("count", 0)
                     Log.d(TAG, "Buttons configured: $count")
@@ -442,14 +921,75 @@ class UsbEncoderManager(private val context: Context) : SerialInputOutputManager
                     Log.d(TAG, "Buttons cleared")
                 }
                 "pong" -> {
-                    Log.d(TAG, "Received pong, position: ${json.optLong("position")}")
+                    latency.pongReceived(json.optLong("t", -1), receivedAt)
+                    Log.d(TAG, "Received pong, count: ${json.optLong("count", json.optLong("position"))}")
                 }
                 "ready" -> {
                     Log.d(TAG, "Encoder device ready: ${json.optString("device")}")
+                    
+                    val commands = json.optJSONArray("commands")
+                    deviceCommands = if (commands != null) {
+                        (0 until commands.length()).map { commands.optString(it) }.toSet()
+                    } else {
+                        emptySet()
+                    }
+                    ledState?.let { if (supportsCommand("led")) sendLedState(it) }
+                    updateCountsPerRev(json)
+                    // The device clock may have restarted with it
+                    latency.resetClock()
+                    
+                    // Sequence baseline: events up to here predate this session.
+                    // A lower number than ours means the device restarted.
+                    val seq = json.optLong("seq", -1)
+                    if (seq >= 0 && (lastEventSeq < 0 || seq < lastEventSeq)) {
+                        lastEventSeq = seq
+                        eventCountKnown = false
+                        resendRequestedAt = 0
+                    }
+                    
+                    if (preferButtonSnapshots && json.optInt("buttonSnapshots", 0) == 1) {
+                        sendCommand(JSONObject().apply {
+                            put("type", "buttons_mode")
+                            put("mode", "snapshot")
+                        })
+                    }
+                    
+                    // Events over HID if this is a HID build
+                    if (preferHidTransport && json.optInt("hid", 0) == HidReport.SIZE) {
+                        startHidTransport()
+                    }
+                    
+                    // Opt into the binary protocol if the firmware speaks our version
+                    if (preferBinaryProtocol && !binaryMode &&
+                        json.optInt("binary", 0) == BinaryProtocol.VERSION) {
+                        sendCommand(JSONObject().apply {
+                            put("type", "protocol")
+                            put("mode", "binary")
+                        })
+                    }
+                }
+                "protocol" -> {
+                    // Everything after this acknowledgement uses the new format
+                    binaryMode = json.optString("mode") == "binary"
+                    frameLength = 0
+                    frameOverflow = false
+                    lineParser.reset()
+                    Log.d(TAG, "Encoder protocol: ${if (binaryMode) "binary" else "json"}")
+                }
+                "resolution" -> {
+                    updateCountsPerRev(json)
+                    Log.d(TAG, "Encoder resolution: ${json.optInt("ppr")} PPR x${json.optInt("decode")}")
+                }
+                "transport" -> {
+                    Log.d(TAG, "Encoder events over ${json.optString("events")}")
+                }
+                "resync" -> {
+                    applyResync(json.optLong("seq"), json.optLong("count"), json.optLong("buttons").toInt())
                 }
-                "heartbeat" -> {
-                    // Heartbeat received, device is alive
+                "events" -> {
+                    Log.d(TAG, "Encoder events: $json")
                 }
+                "heartbeat" -> checkHeartbeatSeq(json.optLong("seq", -1))
             }
         } catch (e: Exception) {
             Log.w(TAG, "Failed to parse message: $line", e)
@@ -107,8 +107,14 @@ class WebSocketManager(private val context: Context) {
         send(message.toString())
     }
 
-    fun sendJogCommand(axis: String, distance: Float, feedRate: Int) {
-        val command = "\$J=G91 $axis${String.format("%.3f", distance)} F$feedRate"
+    /**
+     * @param millimetres add G21, so distance and feed are mm and mm/min
+     *        whatever units the machine's modal state is in (the jog does
+     *        not change that state)
+     */
+    fun sendJogCommand(axis: String, distance: Float, feedRate: Int, millimetres: Boolean = false) {
+        val units = if (millimetres) "G21 " else ""
+        val command = "\$J=G91 $units$axis${String.format("%.3f", distance)} F$feedRate"
         val direction = if (distance > 0) "+" else "-"
         
         val message = JsonObject().apply {
@@ -0,0 +1,248 @@
+package com.cncpendant.app
+
+import org.junit.Assert.assertEquals
+import org.junit.Assert.assertTrue
+import org.junit.Test
+
+/**
+ * JogPlanner against a simulated GRBL planner, compared with the previous
+ * step jogs (one merged jog per 100 ms).
+ *
+ * Run with ./gradlew testDebugUnitTest; the table of results goes to the
+ * test's standard output (build/reports/tests).
+ *
+ * Time advances in 1 ms ticks. The wheel follows a speed profile, jog
+ * commands reach GRBL after a fixed link delay, and GRBL is modelled as a
+ * 15-block planner with one acceleration limit that must always be able to
+ * stop at the end of its queue. Per scenario it prints the travel after the
+ * wheel stops, the time the machine stood still while the wheel turned, the
+ * final position error and the number of jog commands, and checks that:
+ *   - every click the planner kept is travelled, and what it dropped is
+ *     counted in distanceDropped
+ *   - after the wheel stops the machine moves at most one latency window
+ *     plus a segment at the feed cap, one step and the braking distance
+ *   - a wheel turning at a steady pace never leaves the machine standing
+ */
+class JogPlannerSimulationTest {
+    companion object {
+        private const val LINK_MS = 20              // App -> sender -> GRBL
+        private const val ACCEL = 500.0             // mm/s²
+        private const val PLANNER_BLOCKS = 15
+        private const val TARGET_LATENCY_MS = 200   // JogPlanner's defaults
+        private const val SEGMENT_MS = 50
+        private const val RESOLUTION = 0.001        // Per segment, see JogPlanner
+    }
+
+    private val scenarios = listOf(
+        Scenario("slow 5 clicks/s, 0.1 mm", 0.1f, 1000, listOf(3000 to 5f)),
+        Scenario("steady 20 clicks/s, 0.1 mm", 0.1f, 1000, listOf(3000 to 20f), steady = true),
+        Scenario("spin 40 clicks/s, 1 mm", 1f, 2000, listOf(2000 to 40f), steady = true),
+        Scenario("overspeed 60 clicks/s, 1 mm", 1f, 2000, listOf(2000 to 60f), steady = true),
+        Scenario("reverse 20 clicks/s, 0.1 mm", 0.1f, 1000, listOf(1000 to 20f, 1000 to -20f)),
+        Scenario("ramp 5-50 clicks/s, 0.1 mm", 0.1f, 3000,
+            listOf(500 to 5f, 500 to 15f, 500 to 30f, 500 to 50f, 500 to 30f, 500 to 10f))
+    )
+
+    // GRBL's look-ahead, reduced to one axis
+    private class GrblModel {
+        private class Block(var remaining: Double, val direction: Int, val speed: Double)
+
+        private val blocks = ArrayDeque<Block>()
+        var position = 0.0
+            private set
+        var velocity = 0.0
+            private set
+
+        fun push(distance: Float, feed: Int): Boolean {
+            if (blocks.size >= PLANNER_BLOCKS) return false
+            blocks.addLast(Block(kotlin.math.abs(distance.toDouble()), if (distance > 0) 1 else -1, feed / 60.0))
+            return true
+        }
+
+        fun tick(dt: Double) {
+            val current = blocks.firstOrNull()
+            if (current == null) {
+                velocity = 0.0
+                return
+            }
+
+            // Fastest speed from which every later block, a reversal and the end
+            // of the queue can still be reached with the acceleration limit
+            var limit = current.speed
+            var ahead = current.remaining
+            for (i in 1 until blocks.size) {
+                val next = blocks[i]
+                if (next.direction != current.direction) break
+                limit = minOf(limit, kotlin.math.sqrt(next.speed * next.speed + 2 * ACCEL * ahead))
+                ahead += next.remaining
+            }
+            limit = minOf(limit, kotlin.math.sqrt(2 * ACCEL * ahead))
+
+            velocity = if (limit >= velocity) minOf(velocity + ACCEL * dt, limit) else maxOf(velocity - ACCEL * dt, limit)
+            // Creep at the end of a ramp so a block always completes
+            val move = maxOf(velocity, ACCEL * dt / 2) * dt
+            if (move >= current.remaining) {
+                position += current.direction * current.remaining
+                blocks.removeFirst()
+            } else {
+                current.remaining -= move
+                position += current.direction * move
+            }
+        }
+    }
+
+    private class Scenario(
+        val name: String,
+        val step: Float,                // mm per click
+        val maxFeed: Int,               // mm/min
+        val phases: List<Pair<Int, Float>>,    // (duration ms, clicks/s) ...
+        val steady: Boolean = false     // One speed throughout: the machine must keep moving
+    )
+
+    private class Result(
+        val target: Double,
+        val position: Double,
+        val afterStop: Double,
+        val stalledMs: Int,
+        val commands: Int
+    )
+
+    // Turns wheel clicks into jog commands (distance mm, feed mm/min)
+    private interface JogSource {
+        fun clicks(clicks: Int, velocity: Float, nowMs: Long, send: (Float, Int) -> Unit)
+        fun tick(nowMs: Long, send: (Float, Int) -> Unit)
+    }
+
+    private class PlannerSource(private val step: Float, private val maxFeed: Int) : JogSource {
+        val planner = JogPlanner()
+
+        override fun clicks(clicks: Int, velocity: Float, nowMs: Long, send: (Float, Int) -> Unit) {
+            planner.addClicks(clicks, step, velocity, maxFeed, nowMs)
+            tick(nowMs, send)
+        }
+
+        override fun tick(nowMs: Long, send: (Float, Int) -> Unit) {
+            while (true) {
+                val segment = planner.poll(nowMs) ?: break
+                send(segment.distance, segment.feed)
+            }
+        }
+    }
+
+    // MainActivity's step jogs: clicks merged and sent at most every 100 ms at the set feed
+    private class StepJogSource(private val step: Float, private val feed: Int) : JogSource {
+        private var pending = 0
+        private var lastSentAt = -1000L
+
+        override fun clicks(clicks: Int, velocity: Float, nowMs: Long, send: (Float, Int) -> Unit) {
+            pending = (pending + clicks).coerceIn(-20, 20)
+            tick(nowMs, send)
+        }
+
+        override fun tick(nowMs: Long, send: (Float, Int) -> Unit) {
+            if (pending == 0 || nowMs - lastSentAt < 100) return
+            lastSentAt = nowMs
+            send(pending * step, feed)
+            pending = 0
+        }
+    }
+
+    private fun simulate(scenario: Scenario, source: JogSource): Result {
+        val grbl = GrblModel()
+        val link = ArrayDeque<Triple<Long, Float, Int>>()
+        var commands = 0
+        var now = 0L
+        val send: (Float, Int) -> Unit = { distance, feed ->
+            commands++
+            link.addLast(Triple(now + LINK_MS, distance, feed))
+        }
+
+        val wheelEnd = scenario.phases.sumOf { it.first }
+        var phase = 0
+        var phaseEnd = scenario.phases[0].first.toLong()
+        var partial = 0.0
+        var target = 0.0
+        var lastClickAt = -1000L
+        var positionAtStop = 0.0
+        var stalledMs = 0
+
+        while (now < wheelEnd + 5000L) {
+            val wheelTurning = now < wheelEnd
+            if (wheelTurning) {
+                while (now >= phaseEnd) {
+                    phase++
+                    phaseEnd += scenario.phases[phase].first
+                }
+                val speed = scenario.phases[phase].second
+                partial += speed / 1000.0
+                val clicks = partial.toInt()
+                if (clicks != 0) {
+                    partial -= clicks
+                    target += clicks * scenario.step
+                    // The firmware reports 0 for the first click after 250 ms at rest
+                    val velocity = if (now - lastClickAt < 250) speed else 0f
+                    lastClickAt = now
+                    source.clicks(clicks, velocity, now, send)
+                }
+            }
+            if (now % 20 == 0L) source.tick(now, send)
+
+            // Link delay, then GRBL's planner (the sender holds commands while it is full)
+            while (link.isNotEmpty() && link.first().first <= now &&
+                grbl.push(link.first().second, link.first().third)) {
+                link.removeFirst()
+            }
+
+            grbl.tick(0.001)
+            // Standing still while the wheel turns (after the first 300 ms)
+            if (wheelTurning && now >= 300 && grbl.velocity == 0.0) {
+                stalledMs++
+            }
+            if (now == wheelEnd.toLong()) positionAtStop = grbl.position
+            now++
+        }
+
+        return Result(target, grbl.position, kotlin.math.abs(grbl.position - positionAtStop), stalledMs, commands)
+    }
+
+    @Test
+    fun plannerAgainstStepJogs() {
+        println(String.format("%-30s %-8s %10s %10s %10s %10s %8s",
+            "scenario", "source", "target mm", "final mm", "after mm", "stalled ms", "jogs"))
+        for (scenario in scenarios) {
+            val source = PlannerSource(scenario.step, scenario.maxFeed)
+            val planned = simulate(scenario, source)
+            val stepped = simulate(scenario, StepJogSource(scenario.step, scenario.maxFeed))
+            for ((name, r) in listOf("planner" to planned, "step" to stepped)) {
+                println(String.format("%-30s %-8s %10.3f %10.3f %10.3f %10d %8d",
+                    scenario.name, name, r.target, r.position, r.afterStop, r.stalledMs, r.commands))
+            }
+            val planner = source.planner
+            println(String.format("%-30s dropped %.3f mm", "", planner.distanceDropped))
+
+            // Kept clicks all arrive; segments are rounded to the jog resolution
+            val kept = planned.target - kotlin.math.sign(planned.target) * planner.distanceDropped
+            assertEquals("${scenario.name}: kept travel", kept, planned.position,
+                RESOLUTION * planner.segmentsSent + 1e-6)
+
+            val feedMmS = scenario.maxFeed / 60.0
+            val afterStopBound = feedMmS * (TARGET_LATENCY_MS + SEGMENT_MS) / 1000.0 +
+                scenario.step + feedMmS * feedMmS / (2 * ACCEL)
+            assertTrue("${scenario.name}: ${planned.afterStop} mm after stop, bound $afterStopBound",
+                planned.afterStop <= afterStopBound)
+
+            if (scenario.steady) {
+                assertTrue("${scenario.name}: stood still ${planned.stalledMs} ms", planned.stalledMs <= 20)
+            }
+        }
+    }
+
+    @Test
+    fun wheelOutrunningTheFeedIsCountedAsDropped() {
+        val scenario = scenarios.first { it.name.startsWith("overspeed") }
+        val source = PlannerSource(scenario.step, scenario.maxFeed)
+        val result = simulate(scenario, source)
+        assertTrue("nothing dropped at 60 clicks/s", source.planner.distanceDropped > 0.0)
+        assertTrue("dropped more than it was given", source.planner.distanceDropped < result.target)
+    }
+}
@@ -0,0 +1,147 @@
+/**
+ * Minimal Arduino API for the native (Linux) build
+ *
+ * Provides just enough of the Arduino core for src/main.cpp to compile on a
+ * PC: GPIO, pin-change interrupts, a virtual millisecond/microsecond clock
+ * and a Serial port backed by in-memory buffers, plus the pico SDK bank
+ * read and alarm pool calls the firmware uses (alarms fire as the virtual
+ * clock passes their deadline). The hal namespace is the harness side:
+ * drive pins, inject serial input, advance time and read back what the
+ * firmware wrote.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <string>
+
+#define HIGH 0x1
+#define LOW  0x0
+
+#define INPUT        0x0
+#define OUTPUT       0x1
+#define INPUT_PULLUP 0x2
+
+#define CHANGE  1
+#define FALLING 2
+#define RISING  3
+
+#define DEC 10
+
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+typedef void (*voidFuncPtr)(void);
+
+void pinMode(uint8_t pin, uint8_t mode);
+int digitalRead(uint8_t pin);
+void digitalWrite(uint8_t pin, uint8_t val);
+void analogWrite(uint8_t pin, int val);
+
+inline int digitalPinToInterrupt(uint8_t pin) { return pin; }
+void attachInterrupt(int interrupt, voidFuncPtr isr, int mode);
+void detachInterrupt(int interrupt);
+void noInterrupts();
+void interrupts();
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+// ==================== hardware/gpio.h subset ====================
+
+// Levels of all pins, bit n = GPIO n
+uint32_t gpio_get_all();
+
+// ==================== pico/time.h subset ====================
+
+typedef int32_t alarm_id_t;
+typedef int64_t (*alarm_callback_t)(alarm_id_t id, void* user_data);
+struct alarm_pool;
+typedef struct alarm_pool alarm_pool_t;
+
+// Callback return: 0 = done, >0 = fire again that many us after the
+// previous deadline, <0 = fire again that many us from now
+alarm_pool_t* alarm_pool_create_with_unused_hardware_alarm(unsigned int max_timers);
+alarm_id_t alarm_pool_add_alarm_in_us(alarm_pool_t* pool, uint64_t us, alarm_callback_t callback,
+                                      void* user_data, bool fire_if_past);
+bool alarm_pool_cancel_alarm(alarm_pool_t* pool, alarm_id_t alarm_id);
+
+// ==================== Serial ====================
+
+class HardwareSerial {
+public:
+    void begin(unsigned long) {}
+    void end() {}
+    operator bool() const;              // Host has the port open (DTR)
+
+    int available();
+    int availableForWrite();
+    int read();
+    void flush();
+
+    size_t write(uint8_t c);
+    size_t write(const uint8_t* buf, size_t len);
+    size_t write(const char* buf, size_t len) { return write((const uint8_t*)buf, len); }
+
+    size_t print(const char* s);
+    size_t print(char c);
+    size_t print(unsigned char v, int base = DEC) { return print((unsigned long)v, base); }
+    size_t print(int v, int base = DEC) { return print((long)v, base); }
+    size_t print(unsigned int v, int base = DEC) { return print((unsigned long)v, base); }
+    size_t print(long v, int base = DEC);
+    size_t print(unsigned long v, int base = DEC);
+    size_t print(double v, int digits = 2);
+
+    size_t println() { return print("\r\n"); }
+    template <typename T> size_t println(const T& v) {
+        size_t n = print(v);
+        return n + println();
+    }
+};
+
+extern HardwareSerial Serial;
+
+// ==================== Harness hooks ====================
+
+namespace hal {
+    // Set an input pin level, firing its CHANGE interrupt if attached.
+    // Interrupts raised while masked are delivered on interrupts().
+    void setPin(uint8_t pin, uint8_t level);
+
+    // Virtual clock (starts at 0, only moves when told to or on delay()).
+    // Alarms fire at their deadlines as the clock passes them.
+    void advanceMicros(unsigned long us);
+    void advanceMillis(unsigned long ms);
+
+    // Queue bytes for Serial.read()
+    void injectSerial(const char* data);
+
+    // Everything the firmware has written, and how many write/print calls
+    // it took (each call may become its own USB transfer on the device)
+    std::string& serialOutput();
+    unsigned long serialBytesWritten();
+    unsigned long serialWriteCalls();
+    unsigned long serialFlushCalls();
+    void clearSerialOutput();
+
+    // Drop output instead of buffering it (counters still advance)
+    void setSerialCapture(bool enabled);
+
+    // Host side of the port: DTR, and free space in the transmit buffer
+    // (a host that stops reading leaves no room)
+    void setSerialConnected(bool connected);
+    void setSerialWriteRoom(int bytes);
+
+    // Let each write use up that space, as on the device (off by default,
+    // so the benchmarks can write without refilling it)
+    void setSerialWritesUseRoom(bool enabled);
+
+    // Reset pins, interrupts, clock and serial buffers
+    void reset();
+}
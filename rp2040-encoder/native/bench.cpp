@@ -0,0 +1,368 @@
+/**
+ * Benchmark harness for the encoder firmware (native build)
+ *
+ * Runs the real src/main.cpp against the host HAL in Arduino.h and reports:
+ *   decode.*   ns per encoder edge through encoderISR()
+ *   scan.*     ns per loop() pass with buttons configured but idle, and
+ *              ns per debounce sample for 1 vs 26 buttons
+ *   command.*  ns per handleCommand() call, and tokenizer throughput
+ *   output.*   bytes, Serial calls, flushes and ns per outgoing message,
+ *              next to the previous print()-per-field senders (*_legacy)
+ *   latency.*  click-to-wire latency (virtual time) per report mode
+ *   led.*      LED writes per click during a spin, ns per effect render
+ *   profile.*  ns per profiler histogram sample
+ *
+ * Build and run:  pio run -e native -t exec
+ * An optional argument scales the iteration counts (default 1).
+ *
+ * Absolute numbers are host numbers, not RP2040 cycles; compare runs of the
+ * same machine to spot regressions before flashing.
+ */
+
+#include <Arduino.h>
+
+#include "../src/command_parser.h"
+#include "../src/cycle_profile.h"
+#include "../src/led_effects.h"
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+// Firmware entry points (src/main.cpp)
+void setup();
+void loop();
+void handleCommand(const char* line, size_t len);
+void sendEncoderData(int delta, uint32_t position, int64_t count, float velocity, uint32_t captureMicros);
+void sendButtonEvent(uint8_t pin, bool pressed);
+void sendHeartbeat();
+void sendPong(uint32_t position, int64_t count);
+int64_t sampleButtons(alarm_id_t id, void* userData);
+extern uint32_t encoderDialPosition;
+extern int32_t capturedClicks;
+extern uint32_t ledLastWriteUs;
+
+namespace {
+    unsigned long scale = 1;
+
+    // Keeps results observable so the optimiser cannot drop the work
+    volatile long sink = 0;
+
+    template <typename F>
+    double nsPer(unsigned long n, F&& fn) {
+        auto start = std::chrono::steady_clock::now();
+        for (unsigned long i = 0; i < n; i++) fn(i);
+        auto end = std::chrono::steady_clock::now();
+        return std::chrono::duration<double, std::nano>(end - start).count() / (double)n;
+    }
+
+    void report(const char* name, double value, const char* unit) {
+        printf("%-32s %12.2f  %s\n", name, value, unit);
+    }
+
+    void handleCommand(const char* line) {
+        ::handleCommand(line, strlen(line));
+    }
+
+    // Drive A/B through the Gray sequence; direction = +1 or -1
+    void driveEdges(unsigned long edges, int direction) {
+        for (unsigned long i = 0; i < edges; i++) {
+            // Forward toggles A, B, A, B...; reverse starts with B
+            bool toggleA = ((i & 1) == 0) == (direction > 0);
+            uint8_t pin = toggleA ? 0 : 1;
+            hal::setPin(pin, !digitalRead(pin));
+        }
+    }
+
+    void benchDecode() {
+        const unsigned long edges = 2000000 * scale;
+        int clicksBefore = capturedClicks;
+        double ns = nsPer(1, [&](unsigned long) {
+            driveEdges(edges / 2, +1);
+            driveEdges(edges / 2, -1);
+        }) / (double)edges;
+        report("decode.isr", ns, "ns/edge");
+        sink += capturedClicks - clicksBefore;
+    }
+
+    void benchScan() {
+        handleCommand("{\"type\":\"buttons\",\"pins\":[2,3,4,5,6,7,8,9,10,11,12,13]}");
+        const unsigned long passes = 1000000 * scale;
+        double ns = nsPer(passes, [](unsigned long) {
+            hal::advanceMicros(10);
+            loop();
+        });
+        report("scan.loop_12_buttons_idle", ns, "ns/pass");
+
+        handleCommand("{\"type\":\"clear_buttons\"}");
+        ns = nsPer(passes, [](unsigned long) {
+            hal::advanceMicros(10);
+            loop();
+        });
+        report("scan.loop_no_buttons_idle", ns, "ns/pass");
+
+        // One debounce sample covers every pin, so its cost must not grow
+        // with the button count
+        const char* configs[][2] = {
+            {"scan.debounce_tick_1_button", "{\"type\":\"buttons\",\"pins\":[2]}"},
+            {"scan.debounce_tick_26_buttons",
+             "{\"type\":\"buttons\",\"pins\":[2,3,4,5,6,7,8,9,10,11,12,13,14,15,17,18,19,20,21,22,23,24,26,27,28,29]}"},
+        };
+        for (const auto& config : configs) {
+            handleCommand(config[1]);
+            loop();
+            ns = nsPer(passes, [](unsigned long i) {
+                hal::setPin(2, i & 8);
+                sink += sampleButtons(0, nullptr);
+            });
+            report(config[0], ns, "ns/sample");
+        }
+        handleCommand("{\"type\":\"clear_buttons\"}");
+        loop();
+    }
+
+    void benchCommands() {
+        struct Case { const char* name; const char* line; };
+        const Case cases[] = {
+            {"command.ping", "{\"type\":\"ping\"}"},
+            {"command.reset", "{\"type\":\"reset\",\"position\":42}"},
+            {"command.buttons", "{\"type\":\"buttons\",\"pins\":[2,3,4,5,6,7,8,9,10,11,12,13]}"},
+            {"command.clear_buttons", "{\"type\":\"clear_buttons\"}"},
+            {"command.status_text", "status"},
+            {"command.unknown", "{\"type\":\"nope\",\"value\":1}"},
+        };
+        const size_t numCases = sizeof(cases) / sizeof(cases[0]);
+        const unsigned long n = 200000 * scale;
+
+        for (const Case& c : cases) {
+            report(c.name, nsPer(n, [&](unsigned long) { handleCommand(c.line); }), "ns/command");
+        }
+        double mix = nsPer(n, [&](unsigned long i) { handleCommand(cases[i % numCases].line); });
+        report("command.mix", mix, "ns/command");
+
+        // Tokenizer alone, over the widest command the host sends
+        const char* chords = "{\"type\":\"chords\",\"chords\":[[2,5],[2,6,7],[3,4],[8,9,10]]}";
+        size_t len = strlen(chords);
+        double ns = nsPer(n, [&](unsigned long) {
+            JsonCommand cmd;
+            sink += cmd.parse(chords, len) ? cmd.count : 0;
+        });
+        report("command.parse_chords", ns, "ns/line");
+        report("command.parse_throughput", (double)len * 1000.0 / ns, "MB/s");
+    }
+
+    // The JSON senders as they were before messages were built in one
+    // buffer: one print() per field, so one USB transfer per field
+    namespace legacy {
+        void sendEncoderData(int delta, long position, float velocity) {
+            Serial.print("{\"type\":\"encoder\",\"delta\":");
+            Serial.print(delta);
+            Serial.print(",\"position\":");
+            Serial.print(position);
+            Serial.print(",\"velocity\":");
+            Serial.print(velocity, 1);
+            Serial.println("}");
+        }
+
+        void sendButtonEvent(uint8_t pin, bool pressed) {
+            Serial.print("{\"type\":\"button\",\"pin\":");
+            Serial.print(pin);
+            Serial.print(",\"state\":\"");
+            Serial.print(pressed ? "pressed" : "released");
+            Serial.println("\"}");
+        }
+
+        void sendHeartbeat() {
+            Serial.print("{\"type\":\"heartbeat\",\"position\":");
+            Serial.print(encoderDialPosition);
+            Serial.print(",\"pinA\":");
+            Serial.print(digitalRead(0));
+            Serial.print(",\"pinB\":");
+            Serial.print(digitalRead(1));
+            Serial.println("}");
+        }
+
+        void sendPong(long position) {
+            Serial.print("{\"type\":\"pong\",\"position\":");
+            Serial.print(position);
+            Serial.println("}");
+        }
+    }
+
+    template <typename F>
+    void benchMessage(const char* name, F&& send) {
+        const unsigned long n = 200000 * scale;
+        hal::clearSerialOutput();
+        double ns = nsPer(n, send);
+        char label[64];
+        snprintf(label, sizeof(label), "output.%s", name);
+        report(label, ns, "ns/event");
+        snprintf(label, sizeof(label), "output.%s.bytes", name);
+        report(label, (double)hal::serialBytesWritten() / (double)n, "bytes/event");
+        snprintf(label, sizeof(label), "output.%s.calls", name);
+        report(label, (double)hal::serialWriteCalls() / (double)n, "Serial calls/event");
+        snprintf(label, sizeof(label), "output.%s.flushes", name);
+        report(label, (double)hal::serialFlushCalls() / (double)n, "flushes/event");
+    }
+
+    void benchOutput() {
+        benchMessage("encoder", [](unsigned long i) { sendEncoderData((i & 1) ? 3 : -2, i % 100, (int64_t)i * 37, 123.4f, (uint32_t)i * 1000); });
+        benchMessage("button", [](unsigned long i) { sendButtonEvent(2 + (i % 12), i & 1); });
+        benchMessage("heartbeat", [](unsigned long) { sendHeartbeat(); });
+        benchMessage("pong", [](unsigned long i) { sendPong(i % 100, (int64_t)i * 37); });
+
+        benchMessage("encoder_legacy", [](unsigned long i) { legacy::sendEncoderData((i & 1) ? 3 : -2, (long)(i % 100), 123.4f); });
+        benchMessage("button_legacy", [](unsigned long i) { legacy::sendButtonEvent(2 + (i % 12), i & 1); });
+        benchMessage("heartbeat_legacy", [](unsigned long) { legacy::sendHeartbeat(); });
+        benchMessage("pong_legacy", [](unsigned long i) { legacy::sendPong((long)(i % 100)); });
+
+        handleCommand("{\"type\":\"protocol\",\"mode\":\"binary\"}");
+        benchMessage("encoder_binary", [](unsigned long i) { sendEncoderData((i & 1) ? 3 : -2, i % 100, (int64_t)i * 37, 123.4f, (uint32_t)i * 1000); });
+        benchMessage("button_binary", [](unsigned long i) { sendButtonEvent(2 + (i % 12), i & 1); });
+        benchMessage("heartbeat_binary", [](unsigned long) { sendHeartbeat(); });
+        handleCommand("{\"type\":\"protocol\",\"mode\":\"json\"}");
+    }
+
+    // Replay the same handwheel session (single clicks and spins of varying
+    // speed, separated by pauses) under one report setting, and measure how
+    // long each click waits before the message carrying it is written.
+    void benchLatencyMode(const char* name, const char* reportCommand) {
+        const unsigned long STEP_US = 100;
+        const unsigned long bursts = 300 * scale;
+
+        handleCommand(reportCommand);
+        hal::setSerialCapture(true);
+        hal::clearSerialOutput();
+
+        std::deque<unsigned long> pending;      // Capture times of clicks not yet sent
+        std::vector<unsigned long> latencies;
+        unsigned long messages = 0;
+        unsigned long seed = 12345;
+        auto nextRandom = [&seed](unsigned long range) {
+            seed = seed * 1103515245UL + 12345UL;
+            return (seed >> 8) % range;
+        };
+
+        for (unsigned long burst = 0; burst < bursts; burst++) {
+            unsigned long pauseUs = (100 + nextRandom(500)) * 1000;
+            unsigned long clicks = 1 + nextRandom(40);
+            unsigned long periodUs = (1 + nextRandom(30)) * 1000;
+
+            unsigned long nextClickUs = micros() + pauseUs;
+            unsigned long endUs = nextClickUs + clicks * periodUs + pauseUs;
+            while (micros() < endUs) {
+                if (clicks > 0 && micros() >= nextClickUs) {
+                    driveEdges(4, +1);
+                    pending.push_back(micros());
+                    nextClickUs += periodUs;
+                    clicks--;
+                }
+                loop();
+
+                // Hand each encoder message's clicks to the oldest pending ones
+                const char* key = "\"type\":\"encoder\"";
+                std::string& out = hal::serialOutput();
+                size_t at = 0;
+                while ((at = out.find(key, at)) != std::string::npos) {
+                    at = out.find("\"delta\":", at) + strlen("\"delta\":");
+                    long delta = labs(strtol(out.c_str() + at, nullptr, 10));
+                    messages++;
+                    for (long i = 0; i < delta && !pending.empty(); i++) {
+                        latencies.push_back(micros() - pending.front());
+                        pending.pop_front();
+                    }
+                }
+                hal::clearSerialOutput();
+                hal::advanceMicros(STEP_US);
+            }
+        }
+        hal::setSerialCapture(false);
+
+        std::sort(latencies.begin(), latencies.end());
+        size_t n = latencies.size();
+        char label[64];
+        const struct { const char* suffix; double q; } quantiles[] = {{"p50", 0.5}, {"p90", 0.9}, {"p99", 0.99}, {"max", 1.0}};
+        for (const auto& quantile : quantiles) {
+            size_t i = n == 0 ? 0 : std::min(n - 1, (size_t)(quantile.q * (double)n));
+            snprintf(label, sizeof(label), "latency.%s.%s", name, quantile.suffix);
+            report(label, n == 0 ? 0.0 : (double)latencies[i] / 1000.0, "ms");
+        }
+        snprintf(label, sizeof(label), "latency.%s.msgs_per_click", name);
+        report(label, n == 0 ? 0.0 : (double)messages / (double)n, "messages/click");
+    }
+
+    void benchLatency() {
+        benchLatencyMode("fixed_50ms", "{\"type\":\"report\",\"minMs\":50,\"maxMs\":50}");
+        benchLatencyMode("adaptive", "{\"type\":\"report\",\"minMs\":2,\"maxMs\":50}");
+        benchLatencyMode("immediate", "{\"type\":\"report\",\"minMs\":0,\"maxMs\":0}");
+        handleCommand("{\"type\":\"report\",\"minMs\":2,\"maxMs\":50}");
+    }
+
+    // A steady spin flashes the LED on every report; with coalesced
+    // effects it should be written about once per spin, not per message
+    void benchLed() {
+        const unsigned long clicks = 500 * scale;
+        hal::advanceMillis(5000);
+        loop();
+        unsigned long writes = 0;
+        uint32_t lastWrite = ledLastWriteUs;
+        for (unsigned long i = 0; i < clicks; i++) {
+            driveEdges(4, +1);
+            for (int step = 0; step < 20; step++) {
+                loop();
+                if (ledLastWriteUs != lastWrite) {
+                    writes++;
+                    lastWrite = ledLastWriteUs;
+                }
+                hal::advanceMicros(100);
+            }
+        }
+        report("led.writes_per_1000_clicks", (double)writes * 1000.0 / (double)clicks, "writes");
+
+        LedEffects effects;
+        const unsigned long n = 1000000 * scale;
+        double ns = nsPer(n, [&](unsigned long i) {
+            if ((i & 63) == 0) effects.flash(0x00FF00, 50, (uint32_t)i);
+            if ((i & 1023) == 0) effects.pulse(0x0000FF, 200, (uint32_t)i);
+            sink += effects.render((uint32_t)i);
+        });
+        report("led.render", ns, "ns/render");
+    }
+
+    // The profiler adds one sample per loop phase and per encoder edge
+    void benchProfile() {
+        CycleHistogram histogram;
+        const unsigned long n = 10000000 * scale;
+        double ns = nsPer(n, [&](unsigned long i) {
+            // Spread the samples over the buckets
+            histogram.add((uint32_t)(i * 2654435761u) >> (i & 31));
+        });
+        report("profile.histogram_add", ns, "ns/sample");
+        sink += histogram.count();
+    }
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1) {
+        long s = strtol(argv[1], nullptr, 10);
+        if (s > 0) scale = (unsigned long)s;
+    }
+
+    hal::reset();
+    setup();
+    hal::setSerialCapture(false);
+
+    benchDecode();
+    benchScan();
+    benchCommands();
+    benchOutput();
+    benchLatency();
+    benchLed();
+    benchProfile();
+
+    return sink == 0x7FFFFFFF;
+}
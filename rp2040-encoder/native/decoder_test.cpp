@@ -0,0 +1,272 @@
+/**
+ * Decoder tests for the encoder firmware (native build)
+ *
+ * Runs the same pin sequences through both decoders and checks that they
+ * agree:
+ *   - the interrupt decoder: encoderISR() and ENCODER_TABLE in src/main.cpp,
+ *     driven through the shim's pin-change interrupts
+ *   - the PIO decoder: QuadraturePioModel (src/quadrature_model.h) running
+ *     the instruction words from quadrature.pio.h, sampled the way
+ *     pollEncoder() does and fed to the same accumulatePulses()
+ * Both must land on the same captured clicks and the same partial click,
+ * and on the expected counts: one click per 4 edges at x1, with the
+ * direction inversion applied in accumulatePulses().
+ *
+ * Cases: Gray-code runs both ways, reversals mid-click, invalid two-pin
+ * jumps, contact bounce (sampled and too fast to sample), and a full RX
+ * FIFO that drops pushes while the count carries on.
+ *
+ * Build and run:  pio run -e native_test -t exec
+ * Prints one line per failed check and exits non-zero if any failed.
+ */
+
+#include <Arduino.h>
+
+#include "../src/quadrature_model.h"
+
+#include <stdio.h>
+#include <vector>
+
+// Firmware entry points and decoder state (src/main.cpp)
+void setup();
+void accumulatePulses(int32_t pulses);
+extern int accumulatedPulses;
+extern int32_t capturedClicks;
+
+namespace {
+    // Encoder pins (PIN_A/PIN_B in src/main.cpp)
+    const uint8_t PIN_A_TEST = 0;
+    const uint8_t PIN_B_TEST = 1;
+
+    // Cycles between pin changes: the program samples every few cycles
+    const uint32_t SETTLE_CYCLES = 64;
+
+    int failures = 0;
+
+    void check(bool ok, const char* name, const char* what, long got, long expected) {
+        if (ok) return;
+        printf("FAIL %-28s %s: got %ld, expected %ld\n", name, what, got, expected);
+        failures++;
+    }
+
+    // Pin levels (A, B) after each step
+    struct Step {
+        uint8_t a;
+        uint8_t b;
+        bool settle;            // Let the PIO program sample before the next step
+    };
+
+    struct Result {
+        int32_t clicks;
+        int pulses;             // Partial click left in accumulatedPulses
+    };
+
+    // Gray-code steps from the current levels; direction +1 toggles A
+    // first from 11 (as native/bench.cpp drives it), -1 toggles B first
+    void gray(std::vector<Step>& steps, uint8_t& a, uint8_t& b, int edges, int direction) {
+        for (int i = 0; i < edges; i++) {
+            bool toggleA = ((a == b) == (direction > 0));
+            if (toggleA) a ^= 1; else b ^= 1;
+            steps.push_back({a, b, true});
+        }
+    }
+
+    Result runInterrupt(const std::vector<Step>& steps) {
+        int32_t clicksBefore = capturedClicks;
+        int pulsesBefore = accumulatedPulses;
+        for (const Step& s : steps) {
+            if (digitalRead(PIN_A_TEST) != s.a) hal::setPin(PIN_A_TEST, s.a);
+            if (digitalRead(PIN_B_TEST) != s.b) hal::setPin(PIN_B_TEST, s.b);
+        }
+        return {capturedClicks - clicksBefore, accumulatedPulses - pulsesBefore};
+    }
+
+    // The PIO path; samples after every settled step like loop1() would
+    Result runPio(QuadraturePioModel& pio, const std::vector<Step>& steps, bool sampleEachStep) {
+        int32_t clicksBefore = capturedClicks;
+        int pulsesBefore = accumulatedPulses;
+        int32_t last = pio.getCount();
+        for (const Step& s : steps) {
+            pio.setPins(s.a, s.b);
+            if (!s.settle) continue;
+            pio.step(SETTLE_CYCLES);
+            if (!sampleEachStep) continue;
+            int32_t count = pio.getCount();
+            accumulatePulses((int32_t)((uint32_t)count - (uint32_t)last));
+            last = count;
+        }
+        pio.step(SETTLE_CYCLES);
+        int32_t count = pio.getCount();
+        accumulatePulses((int32_t)((uint32_t)count - (uint32_t)last));
+        return {capturedClicks - clicksBefore, accumulatedPulses - pulsesBefore};
+    }
+
+    // Run one case through both decoders from the current pin levels
+    void runCase(const char* name, const std::vector<Step>& steps, int32_t expectedClicks,
+                 bool sampleEachStep = true) {
+        uint8_t a = digitalRead(PIN_A_TEST);
+        uint8_t b = digitalRead(PIN_B_TEST);
+        QuadraturePioModel pio(a, b);
+        pio.step(SETTLE_CYCLES);
+
+        // The PIO path runs first, while the shim's pins (and with them
+        // the interrupt decoder) stay where they are; both start from the
+        // same partial click
+        int partial = accumulatedPulses;
+        Result fromPio = runPio(pio, steps, sampleEachStep);
+        accumulatedPulses = partial;
+        Result fromIsr = runInterrupt(steps);
+
+        check(fromIsr.clicks == expectedClicks, name, "interrupt clicks", fromIsr.clicks, expectedClicks);
+        check(fromPio.clicks == fromIsr.clicks, name, "PIO clicks vs interrupt", fromPio.clicks, fromIsr.clicks);
+        check(fromPio.pulses == fromIsr.pulses, name, "PIO partial vs interrupt", fromPio.pulses, fromIsr.pulses);
+    }
+
+    // Drop the partial click both decoders share, so cases start on a detent
+    void settlePartial() {
+        accumulatedPulses = 0;
+    }
+
+    void testGray() {
+        uint8_t a = digitalRead(PIN_A_TEST);
+        uint8_t b = digitalRead(PIN_B_TEST);
+        std::vector<Step> steps;
+        gray(steps, a, b, 400, +1);
+        runCase("gray.forward_400_edges", steps, 100);
+        settlePartial();
+
+        steps.clear();
+        gray(steps, a, b, 400, -1);
+        runCase("gray.reverse_400_edges", steps, -100);
+        settlePartial();
+
+        steps.clear();
+        gray(steps, a, b, 3, +1);
+        runCase("gray.partial_click", steps, 0);
+        settlePartial();
+    }
+
+    void testReversal() {
+        uint8_t a = digitalRead(PIN_A_TEST);
+        uint8_t b = digitalRead(PIN_B_TEST);
+        std::vector<Step> steps;
+        // Two edges into a click and back again
+        gray(steps, a, b, 2, +1);
+        gray(steps, a, b, 2, -1);
+        runCase("reversal.mid_click", steps, 0);
+        settlePartial();
+
+        // Past a detent and back: one click each way
+        steps.clear();
+        gray(steps, a, b, 6, +1);
+        gray(steps, a, b, 6, -1);
+        runCase("reversal.across_detent", steps, 0);
+        settlePartial();
+
+        // Back and forth every edge
+        steps.clear();
+        for (int i = 0; i < 50; i++) {
+            gray(steps, a, b, 1, +1);
+            gray(steps, a, b, 1, -1);
+        }
+        runCase("reversal.dither", steps, 0);
+        settlePartial();
+    }
+
+    void testInvalid() {
+        uint8_t a = digitalRead(PIN_A_TEST);
+        uint8_t b = digitalRead(PIN_B_TEST);
+        std::vector<Step> steps;
+        // Both pins flip between samples: no direction, counted as nothing
+        for (int i = 0; i < 8; i++) {
+            a ^= 1;
+            b ^= 1;
+            steps.push_back({a, b, true});
+        }
+        // The shim fires one interrupt per pin, so the interrupt decoder
+        // sees a valid edge pair there; compare the PIO model on its own
+        QuadraturePioModel pio(digitalRead(PIN_A_TEST), digitalRead(PIN_B_TEST));
+        pio.step(SETTLE_CYCLES);
+        Result fromPio = runPio(pio, steps, true);
+        check(fromPio.clicks == 0, "invalid.both_pins", "PIO clicks", fromPio.clicks, 0);
+        check(fromPio.pulses == 0, "invalid.both_pins", "PIO partial", fromPio.pulses, 0);
+        settlePartial();
+    }
+
+    void testBounce() {
+        uint8_t a = digitalRead(PIN_A_TEST);
+        uint8_t b = digitalRead(PIN_B_TEST);
+        std::vector<Step> steps;
+        // A chatters on every edge before settling: each chatter is a
+        // forward and a backward edge, so the net is the clean run
+        for (int i = 0; i < 40; i++) {
+            uint8_t fromA = a;
+            uint8_t fromB = b;
+            gray(steps, a, b, 1, +1);
+            Step edge = steps.back();
+            steps.push_back({fromA, fromB, true});
+            steps.push_back(edge);
+        }
+        runCase("bounce.sampled", steps, 10);
+        settlePartial();
+
+        // Chatter faster than the program samples: the PIO decoder never
+        // sees it, the interrupt decoder sees and cancels it
+        steps.clear();
+        for (int i = 0; i < 40; i++) {
+            uint8_t fromA = a;
+            uint8_t fromB = b;
+            gray(steps, a, b, 1, +1);
+            Step edge = steps.back();
+            steps.back().settle = false;
+            steps.push_back({fromA, fromB, false});
+            steps.push_back(edge);
+        }
+        runCase("bounce.unsampled", steps, 10);
+        settlePartial();
+    }
+
+    // Nobody reads the FIFO for a long run: pushes are dropped once it is
+    // full, but X keeps the count, so one late sample has every edge
+    void testFullFifo() {
+        uint8_t a = digitalRead(PIN_A_TEST);
+        uint8_t b = digitalRead(PIN_B_TEST);
+        std::vector<Step> steps;
+        gray(steps, a, b, 800, +1);
+
+        QuadraturePioModel pio(digitalRead(PIN_A_TEST), digitalRead(PIN_B_TEST));
+        pio.step(SETTLE_CYCLES);
+        int partial = accumulatedPulses;
+        Result fromPio = runPio(pio, steps, false);
+        accumulatedPulses = partial;
+        check(pio.droppedPushes() > 0, "fifo.full", "dropped pushes", (long)pio.droppedPushes(), 1);
+        check(fromPio.clicks == 200, "fifo.full", "PIO clicks", fromPio.clicks, 200);
+
+        Result fromIsr = runInterrupt(steps);
+        check(fromIsr.clicks == 200, "fifo.full", "interrupt clicks", fromIsr.clicks, 200);
+        settlePartial();
+
+        // Filling it up without movement leaves the count where it was
+        QuadraturePioModel idle(digitalRead(PIN_A_TEST), digitalRead(PIN_B_TEST));
+        idle.step(10000);
+        check(idle.rxLevel() == QuadraturePioModel::RX_FIFO_DEPTH, "fifo.idle", "RX level",
+              idle.rxLevel(), QuadraturePioModel::RX_FIFO_DEPTH);
+        check(idle.getCount() == 0, "fifo.idle", "count", idle.getCount(), 0);
+    }
+}
+
+int main() {
+    hal::reset();
+    setup();
+    hal::setSerialCapture(false);
+    settlePartial();
+
+    testGray();
+    testReversal();
+    testInvalid();
+    testBounce();
+    testFullFifo();
+
+    printf("%s (%d failed checks)\n", failures == 0 ? "PASS" : "FAIL", failures);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,338 @@
+/**
+ * Native implementation of the Arduino subset declared in Arduino.h
+ */
+
+#include <Arduino.h>
+
+#include <stdio.h>
+
+namespace {
+    const uint8_t NUM_PINS = 30;
+
+    uint8_t pinLevel[NUM_PINS];
+    voidFuncPtr pinIsr[NUM_PINS];
+    bool pinIsrPending[NUM_PINS];
+    bool interruptsEnabled = true;
+
+    unsigned long clockMicros = 0;
+
+    struct Alarm {
+        alarm_id_t id;             // 0 = free slot
+        unsigned long due;
+        alarm_callback_t callback;
+        void* userData;
+    };
+
+    const uint8_t MAX_ALARMS = 8;
+    Alarm alarms[MAX_ALARMS];
+    alarm_id_t nextAlarmId = 1;
+    bool firingAlarms = false;
+
+    std::string serialIn;
+    size_t serialInPos = 0;
+    std::string serialOut;
+    bool serialCapture = true;
+    unsigned long serialBytes = 0;
+    unsigned long serialCalls = 0;
+    unsigned long serialFlushes = 0;
+    bool serialConnected = true;
+    int serialWriteRoom = 4096;
+    bool serialWritesUseRoom = false;
+
+    void deliverPendingInterrupts() {
+        for (uint8_t pin = 0; pin < NUM_PINS; pin++) {
+            if (pinIsrPending[pin] && pinIsr[pin]) {
+                pinIsrPending[pin] = false;
+                pinIsr[pin]();
+            }
+        }
+    }
+
+    // Run every alarm whose deadline the clock has reached, earliest first
+    void fireDueAlarms() {
+        if (firingAlarms || !interruptsEnabled) return;
+        firingAlarms = true;
+        for (;;) {
+            Alarm* next = nullptr;
+            for (Alarm& alarm : alarms) {
+                if (alarm.id != 0 && alarm.due <= clockMicros && (!next || alarm.due < next->due)) next = &alarm;
+            }
+            if (!next) break;
+
+            int64_t again = next->callback(next->id, next->userData);
+            if (again > 0) {
+                next->due += (unsigned long)again;
+            } else if (again < 0) {
+                next->due = clockMicros + (unsigned long)(-again);
+            } else {
+                next->id = 0;
+            }
+        }
+        firingAlarms = false;
+    }
+
+    // Move the clock forward, stopping at each alarm deadline on the way so
+    // callbacks see their own fire time
+    void advanceClock(unsigned long us) {
+        unsigned long target = clockMicros + us;
+        while (interruptsEnabled && !firingAlarms) {
+            unsigned long due = target + 1;
+            for (const Alarm& alarm : alarms) {
+                if (alarm.id != 0 && alarm.due < due) due = alarm.due;
+            }
+            if (due > target) break;
+            if (due > clockMicros) clockMicros = due;
+            fireDueAlarms();
+        }
+        clockMicros = target;
+    }
+
+    size_t serialSink(const char* buf, size_t len) {
+        serialCalls++;
+        serialBytes += len;
+        if (serialWritesUseRoom) serialWriteRoom = serialWriteRoom > (int)len ? serialWriteRoom - (int)len : 0;
+        if (serialCapture) serialOut.append(buf, len);
+        return len;
+    }
+}
+
+HardwareSerial Serial;
+
+// ==================== GPIO ====================
+
+void pinMode(uint8_t pin, uint8_t mode) {
+    // Pull-ups idle high, like an open button or encoder contact
+    if (pin < NUM_PINS && mode == INPUT_PULLUP) pinLevel[pin] = HIGH;
+}
+
+int digitalRead(uint8_t pin) {
+    return pin < NUM_PINS ? pinLevel[pin] : LOW;
+}
+
+void digitalWrite(uint8_t pin, uint8_t val) {
+    if (pin < NUM_PINS) pinLevel[pin] = val ? HIGH : LOW;
+}
+
+void analogWrite(uint8_t, int) {}
+
+uint32_t gpio_get_all() {
+    uint32_t levels = 0;
+    for (uint8_t pin = 0; pin < NUM_PINS; pin++) {
+        if (pinLevel[pin]) levels |= 1u << pin;
+    }
+    return levels;
+}
+
+void attachInterrupt(int interrupt, voidFuncPtr isr, int mode) {
+    // Only CHANGE is used by the firmware
+    if (interrupt >= 0 && interrupt < NUM_PINS && mode == CHANGE) pinIsr[interrupt] = isr;
+}
+
+void detachInterrupt(int interrupt) {
+    if (interrupt >= 0 && interrupt < NUM_PINS) pinIsr[interrupt] = nullptr;
+}
+
+void noInterrupts() {
+    interruptsEnabled = false;
+}
+
+void interrupts() {
+    interruptsEnabled = true;
+    deliverPendingInterrupts();
+    fireDueAlarms();
+}
+
+// ==================== Time ====================
+
+unsigned long millis() {
+    return clockMicros / 1000;
+}
+
+unsigned long micros() {
+    return clockMicros;
+}
+
+void delay(unsigned long ms) {
+    advanceClock(ms * 1000);
+}
+
+void delayMicroseconds(unsigned int us) {
+    advanceClock(us);
+}
+
+// ==================== Alarms ====================
+
+// One shared pool; the handle only has to be non-null
+alarm_pool_t* alarm_pool_create_with_unused_hardware_alarm(unsigned int) {
+    return reinterpret_cast<alarm_pool_t*>(alarms);
+}
+
+alarm_id_t alarm_pool_add_alarm_in_us(alarm_pool_t*, uint64_t us, alarm_callback_t callback,
+                                      void* userData, bool) {
+    for (Alarm& alarm : alarms) {
+        if (alarm.id != 0) continue;
+        alarm.id = nextAlarmId++;
+        alarm.due = clockMicros + (unsigned long)us;
+        alarm.callback = callback;
+        alarm.userData = userData;
+        return alarm.id;
+    }
+    return -1;
+}
+
+bool alarm_pool_cancel_alarm(alarm_pool_t*, alarm_id_t alarmId) {
+    for (Alarm& alarm : alarms) {
+        if (alarm.id == alarmId && alarmId != 0) {
+            alarm.id = 0;
+            return true;
+        }
+    }
+    return false;
+}
+
+// ==================== Serial ====================
+
+HardwareSerial::operator bool() const {
+    return serialConnected;
+}
+
+int HardwareSerial::availableForWrite() {
+    return serialWriteRoom;
+}
+
+int HardwareSerial::available() {
+    return (int)(serialIn.size() - serialInPos);
+}
+
+int HardwareSerial::read() {
+    if (serialInPos >= serialIn.size()) return -1;
+    return (uint8_t)serialIn[serialInPos++];
+}
+
+void HardwareSerial::flush() {
+    serialFlushes++;
+}
+
+size_t HardwareSerial::write(uint8_t c) {
+    return serialSink((const char*)&c, 1);
+}
+
+size_t HardwareSerial::write(const uint8_t* buf, size_t len) {
+    return serialSink((const char*)buf, len);
+}
+
+size_t HardwareSerial::print(const char* s) {
+    return serialSink(s, strlen(s));
+}
+
+size_t HardwareSerial::print(char c) {
+    return serialSink(&c, 1);
+}
+
+size_t HardwareSerial::print(long v, int) {
+    char buf[24];
+    int n = snprintf(buf, sizeof(buf), "%ld", v);
+    return serialSink(buf, (size_t)n);
+}
+
+size_t HardwareSerial::print(unsigned long v, int) {
+    char buf[24];
+    int n = snprintf(buf, sizeof(buf), "%lu", v);
+    return serialSink(buf, (size_t)n);
+}
+
+size_t HardwareSerial::print(double v, int digits) {
+    char buf[32];
+    int n = snprintf(buf, sizeof(buf), "%.*f", digits, v);
+    return serialSink(buf, (size_t)n);
+}
+
+// ==================== Harness hooks ====================
+
+namespace hal {
+    void setPin(uint8_t pin, uint8_t level) {
+        if (pin >= NUM_PINS) return;
+        level = level ? HIGH : LOW;
+        if (pinLevel[pin] == level) return;
+        pinLevel[pin] = level;
+        if (!pinIsr[pin]) return;
+        if (interruptsEnabled) {
+            pinIsr[pin]();
+        } else {
+            pinIsrPending[pin] = true;
+        }
+    }
+
+    void advanceMicros(unsigned long us) {
+        advanceClock(us);
+    }
+
+    void advanceMillis(unsigned long ms) {
+        advanceClock(ms * 1000);
+    }
+
+    void injectSerial(const char* data) {
+        if (serialInPos >= serialIn.size()) {
+            serialIn.clear();
+            serialInPos = 0;
+        }
+        serialIn += data;
+    }
+
+    std::string& serialOutput() {
+        return serialOut;
+    }
+
+    unsigned long serialBytesWritten() {
+        return serialBytes;
+    }
+
+    unsigned long serialWriteCalls() {
+        return serialCalls;
+    }
+
+    unsigned long serialFlushCalls() {
+        return serialFlushes;
+    }
+
+    void clearSerialOutput() {
+        serialOut.clear();
+        serialBytes = 0;
+        serialCalls = 0;
+        serialFlushes = 0;
+    }
+
+    void setSerialCapture(bool enabled) {
+        serialCapture = enabled;
+    }
+
+    void setSerialConnected(bool connected) {
+        serialConnected = connected;
+    }
+
+    void setSerialWriteRoom(int bytes) {
+        serialWriteRoom = bytes;
+    }
+
+    void setSerialWritesUseRoom(bool enabled) {
+        serialWritesUseRoom = enabled;
+    }
+
+    void reset() {
+        for (uint8_t pin = 0; pin < NUM_PINS; pin++) {
+            pinLevel[pin] = LOW;
+            pinIsr[pin] = nullptr;
+            pinIsrPending[pin] = false;
+        }
+        interruptsEnabled = true;
+        clockMicros = 0;
+        for (Alarm& alarm : alarms) alarm.id = 0;
+        serialIn.clear();
+        serialInPos = 0;
+        clearSerialOutput();
+        serialCapture = true;
+        serialConnected = true;
+        serialWriteRoom = 4096;
+        serialWritesUseRoom = false;
+    }
+}
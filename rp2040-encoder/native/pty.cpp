@@ -0,0 +1,124 @@
+/**
+ * The firmware on a pseudo-terminal (native build)
+ *
+ * Runs the real src/main.cpp in real time with Serial bridged to a pty, so
+ * host tools (tools/link_bench.cpp, a serial monitor) can talk to it like
+ * the board's /dev/ttyACM port. Prints the pty path, then serves until
+ * killed.
+ *
+ * Build and run:  pio run -e native_pty -t exec
+ * Options:        --tx-buffer N   transmit buffer the firmware sees, bytes
+ *                                 (default 256, the RP2040 core's CDC buffer)
+ *
+ * The virtual clock follows the host's monotonic clock. Output the pty
+ * cannot take yet is held here and counts against the transmit buffer, so
+ * a host that stops reading fills it as it would on the device.
+ */
+
+#include <Arduino.h>
+
+#include <chrono>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <termios.h>
+#include <unistd.h>
+
+// Firmware entry points (src/main.cpp)
+void setup();
+void loop();
+
+namespace {
+    // Loop pass interval while idle; short enough for kHz bench floods
+    const long IDLE_POLL_NS = 100000;
+
+    int openPty(std::string& path, int& slave) {
+        int master = posix_openpt(O_RDWR | O_NOCTTY);
+        if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) return -1;
+        const char* name = ptsname(master);
+        if (!name) return -1;
+        path = name;
+
+        // Hold the slave open in raw mode: no echo or line editing for the
+        // host, and reads on the master do not fail between host sessions
+        slave = open(name, O_RDWR | O_NOCTTY);
+        if (slave < 0) return -1;
+        termios tio;
+        if (tcgetattr(slave, &tio) == 0) {
+            cfmakeraw(&tio);
+            tcsetattr(slave, TCSANOW, &tio);
+        }
+        fcntl(master, F_SETFL, fcntl(master, F_GETFL) | O_NONBLOCK);
+        return master;
+    }
+}
+
+int main(int argc, char** argv) {
+    size_t txBuffer = 256;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--tx-buffer") == 0 && i + 1 < argc) {
+            long n = strtol(argv[++i], nullptr, 10);
+            if (n > 0) txBuffer = (size_t)n;
+        }
+    }
+
+    std::string path;
+    int slave = -1;
+    int master = openPty(path, slave);
+    if (master < 0) {
+        perror("pty");
+        return 1;
+    }
+    printf("%s\n", path.c_str());
+    fflush(stdout);
+
+    hal::reset();
+    hal::setSerialWriteRoom((int)txBuffer);
+    hal::setSerialWritesUseRoom(true);
+    setup();
+
+    auto start = std::chrono::steady_clock::now();
+    unsigned long clock = 0;
+    std::string pending;           // Written by the firmware, not yet taken by the pty
+    char input[512];
+
+    for (;;) {
+        pollfd fd = {master, (short)(POLLIN | (pending.empty() ? 0 : POLLOUT)), 0};
+        timespec timeout = {0, IDLE_POLL_NS};
+        ppoll(&fd, 1, &timeout, nullptr);
+
+        for (;;) {
+            ssize_t n = read(master, input, sizeof(input) - 1);
+            if (n <= 0) break;
+            input[n] = '\0';
+            hal::injectSerial(input);
+        }
+
+        unsigned long now = (unsigned long)std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start).count();
+        if (now > clock) {
+            hal::advanceMicros(now - clock);
+            clock = now;
+        }
+        loop();
+
+        std::string& out = hal::serialOutput();
+        if (!out.empty()) {
+            pending += out;
+            hal::clearSerialOutput();
+        }
+        while (!pending.empty()) {
+            ssize_t n = write(master, pending.data(), pending.size());
+            if (n <= 0) {
+                if (n < 0 && errno != EAGAIN && errno != EINTR) pending.clear();
+                break;
+            }
+            pending.erase(0, (size_t)n);
+        }
+        hal::setSerialWriteRoom(pending.size() >= txBuffer ? 0 : (int)(txBuffer - pending.size()));
+    }
+}
@@ -0,0 +1,126 @@
+/**
+ * Compact binary framing for device -> host messages
+ *
+ * Used instead of JSON lines once the host sends
+ * {"type":"protocol","mode":"binary"}. Every message is one record:
+ *
+ *   wire:    COBS( record | crc16 ) 0x00
+ *   record:  type byte, then a fixed little-endian payload per type
+ *   crc16:   CRC-16/CCITT-FALSE over the record, little-endian
+ *
+ * COBS removes every 0x00 from the frame, so 0x00 always marks a frame
+ * boundary and a receiver can resynchronise after a corrupt frame.
+ * UsbEncoderManager.kt (BinaryProtocol.kt) holds the matching decoder.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+const uint8_t BINARY_PROTOCOL_VERSION = 5;
+
+// Record types and sizes (type byte included, CRC excluded). Event records
+// end in their uint32 sequence number; the heartbeat carries the last one sent.
+const uint8_t REC_ENCODER = 0x01;     // int16 delta, int32 position, int16 velocity (0.1 counts/s), int64 count, uint32 t, uint32 tx, uint32 seq
+const uint8_t REC_BUTTON = 0x02;      // uint8 pin, uint8 pressed, uint32 seq
+const uint8_t REC_HEARTBEAT = 0x03;   // int32 position, uint8 pins (bit0 = A, bit1 = B), int64 count, uint32 seq
+const uint8_t REC_PONG = 0x04;        // int32 position, int64 count, uint32 t
+const uint8_t REC_BUTTON_STATE = 0x05; // uint32 mask, uint32 changed, uint32 micros (snapshot mode), uint32 seq
+const uint8_t REC_CHORD = 0x06;       // uint8 chord id, uint8 pressed, uint32 micros, uint32 seq
+const uint8_t REC_BENCH = 0x07;       // uint8 kind (1 echo, 2 flood), uint32 seq, uint32 rx/due, uint32 tx, zero padding
+const uint8_t REC_TEXT = 0x7F;        // JSON reply text, variable length
+
+const size_t REC_ENCODER_SIZE = 29;
+const size_t REC_BUTTON_SIZE = 7;
+const size_t REC_HEARTBEAT_SIZE = 18;
+const size_t REC_PONG_SIZE = 17;
+const size_t REC_BUTTON_STATE_SIZE = 17;
+const size_t REC_CHORD_SIZE = 11;
+const size_t REC_BENCH_SIZE = 14;     // Without padding
+
+const size_t MAX_RECORD_SIZE = 512;
+
+// Worst-case framed size of a record: CRC, COBS overhead and delimiter
+constexpr size_t framedSize(size_t recordLen) {
+    return recordLen + 2 + (recordLen + 2) / 254 + 1 + 1;
+}
+
+// CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF)
+inline uint16_t crc16Ccitt(const uint8_t* data, size_t len) {
+    uint16_t crc = 0xFFFF;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= (uint16_t)data[i] << 8;
+        for (uint8_t bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+// COBS-encode len bytes into dst (no trailing delimiter). Returns the
+// encoded length; dst must hold len + len / 254 + 1 bytes.
+inline size_t cobsEncode(const uint8_t* src, size_t len, uint8_t* dst) {
+    size_t codeIdx = 0;
+    size_t out = 1;
+    uint8_t code = 1;
+    for (size_t i = 0; i < len; i++) {
+        if (src[i] == 0) {
+            dst[codeIdx] = code;
+            codeIdx = out++;
+            code = 1;
+        } else {
+            dst[out++] = src[i];
+            code++;
+            if (code == 0xFF) {
+                dst[codeIdx] = code;
+                codeIdx = out++;
+                code = 1;
+            }
+        }
+    }
+    dst[codeIdx] = code;
+    return out;
+}
+
+// Decode one COBS frame (delimiter stripped). Returns the decoded length,
+// or 0 if the frame is malformed.
+inline size_t cobsDecode(const uint8_t* src, size_t len, uint8_t* dst) {
+    size_t in = 0;
+    size_t out = 0;
+    while (in < len) {
+        uint8_t code = src[in++];
+        if (code == 0 || in + code - 1 > len) return 0;
+        for (uint8_t i = 1; i < code; i++) {
+            dst[out++] = src[in++];
+        }
+        if (code != 0xFF && in < len) dst[out++] = 0;
+    }
+    return out;
+}
+
+inline void putLe16(uint8_t* p, uint16_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+inline void putLe32(uint8_t* p, uint32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+inline void putLe64(uint8_t* p, uint64_t v) {
+    putLe32(p, (uint32_t)v);
+    putLe32(p + 4, (uint32_t)(v >> 32));
+}
+
+// Append the CRC to record (which needs 2 spare bytes), COBS-encode it
+// into out and terminate with 0x00. Returns the number of bytes to send.
+inline size_t frameRecord(uint8_t* record, size_t len, uint8_t* out) {
+    putLe16(record + len, crc16Ccitt(record, len));
+    size_t n = cobsEncode(record, len + 2, out);
+    out[n++] = 0x00;
+    return n;
+}
@@ -0,0 +1,303 @@
+/**
+ * Allocation-free host command parsing
+ *
+ * Host commands are one flat JSON object per line, e.g.
+ * {"type":"reset","position":0}. CommandLine collects bytes into a fixed
+ * buffer. JsonCommand tokenizes a finished line in a single pass into a
+ * small table of fields that point back into the line. Numbers are
+ * converted during the pass; strings and arrays are kept as spans.
+ * JsonArrayReader walks an array span on demand. Nothing is copied onto
+ * the heap, so a long uptime or a burst of commands cannot fragment it.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+// Text inside the command line (not NUL-terminated)
+struct JsonSpan {
+    const char* ptr = nullptr;
+    uint16_t len = 0;
+
+    bool equals(const char* text) const {
+        return ptr != nullptr && strncmp(ptr, text, len) == 0 && text[len] == '\0';
+    }
+};
+
+enum JsonKind : uint8_t {
+    JSON_NUMBER,    // number holds the integer part
+    JSON_STRING,    // value is the raw text between the quotes
+    JSON_LITERAL,   // true / false / null; number = 1 for true
+    JSON_ARRAY,     // value includes the brackets
+    JSON_OBJECT,    // value includes the braces
+};
+
+struct JsonField {
+    JsonSpan key;
+    JsonSpan value;
+    JsonKind kind;
+    int64_t number;
+};
+
+namespace json_detail {
+    inline bool isSpace(char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\n'; }
+    inline bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+    inline const char* skipSpace(const char* p, const char* end) {
+        while (p < end && isSpace(*p)) p++;
+        return p;
+    }
+
+    // Past the closing quote of a string starting after its opening quote
+    inline const char* skipString(const char* p, const char* end) {
+        while (p < end && *p != '"') {
+            if (*p == '\\') p++;
+            p++;
+        }
+        return p < end ? p + 1 : nullptr;
+    }
+
+    // Past the bracket closing the array/object that starts at p
+    inline const char* skipNested(const char* p, const char* end) {
+        int depth = 0;
+        while (p < end) {
+            char c = *p++;
+            if (c == '"') {
+                p = skipString(p, end);
+                if (!p) return nullptr;
+            } else if (c == '[' || c == '{') {
+                depth++;
+            } else if (c == ']' || c == '}') {
+                if (--depth == 0) return p;
+            }
+        }
+        return nullptr;
+    }
+
+    // Integer part of a JSON number; the fraction and exponent are skipped
+    template <typename T>
+    inline const char* parseNumber(const char* p, const char* end, T& value) {
+        bool negative = p < end && *p == '-';
+        if (negative) p++;
+        if (p >= end || !isDigit(*p)) return nullptr;
+        T result = 0;
+        while (p < end && isDigit(*p)) result = result * 10 + (*p++ - '0');
+        while (p < end && (isDigit(*p) || *p == '.' || *p == 'e' || *p == 'E' || *p == '+' || *p == '-')) p++;
+        value = negative ? -result : result;
+        return p;
+    }
+}
+
+class JsonCommand {
+public:
+    static const uint8_t MAX_FIELDS = 8;   // Further fields are parsed but not kept
+
+    // Tokenize one line. Returns false if it is not a JSON object.
+    bool parse(const char* line, size_t length) {
+        using namespace json_detail;
+        count = 0;
+        const char* end = line + length;
+        const char* p = skipSpace(line, end);
+        if (p >= end || *p != '{') return false;
+        p = skipSpace(p + 1, end);
+        if (p < end && *p == '}') return true;
+
+        while (p < end) {
+            JsonField field;
+            if (*p != '"') return false;
+            field.key.ptr = p + 1;
+            p = skipString(p + 1, end);
+            if (!p) return false;
+            field.key.len = (uint16_t)(p - 1 - field.key.ptr);
+
+            p = skipSpace(p, end);
+            if (p >= end || *p != ':') return false;
+            p = skipSpace(p + 1, end);
+            if (p >= end) return false;
+
+            field.number = 0;
+            const char* valueStart = p;
+            if (*p == '"') {
+                field.kind = JSON_STRING;
+                valueStart = p + 1;
+                p = skipString(p + 1, end);
+                if (!p) return false;
+                field.value.ptr = valueStart;
+                field.value.len = (uint16_t)(p - 1 - valueStart);
+            } else {
+                if (*p == '[' || *p == '{') {
+                    field.kind = *p == '[' ? JSON_ARRAY : JSON_OBJECT;
+                    p = skipNested(p, end);
+                } else if (*p == '-' || isDigit(*p)) {
+                    field.kind = JSON_NUMBER;
+                    p = parseNumber(p, end, field.number);
+                } else {
+                    field.kind = JSON_LITERAL;
+                    while (p < end && *p >= 'a' && *p <= 'z') p++;
+                    field.number = (p - valueStart == 4 && strncmp(valueStart, "true", 4) == 0) ? 1 : 0;
+                }
+                if (!p) return false;
+                field.value.ptr = valueStart;
+                field.value.len = (uint16_t)(p - valueStart);
+            }
+            if (count < MAX_FIELDS) fields[count++] = field;
+
+            p = skipSpace(p, end);
+            if (p >= end) return false;
+            if (*p == '}') return true;
+            if (*p != ',') return false;
+            p = skipSpace(p + 1, end);
+        }
+        return false;
+    }
+
+    const JsonField* field(const char* key) const {
+        for (uint8_t i = 0; i < count; i++) {
+            if (fields[i].key.equals(key)) return &fields[i];
+        }
+        return nullptr;
+    }
+
+    bool getLong(const char* key, long& value) const {
+        const JsonField* f = field(key);
+        if (!f || f->kind != JSON_NUMBER) return false;
+        value = (long)f->number;
+        return true;
+    }
+
+    bool getInt64(const char* key, int64_t& value) const {
+        const JsonField* f = field(key);
+        if (!f || f->kind != JSON_NUMBER) return false;
+        value = f->number;
+        return true;
+    }
+
+    // true/false, or a number (non-zero is true)
+    bool getBool(const char* key, bool& value) const {
+        const JsonField* f = field(key);
+        if (!f || (f->kind != JSON_LITERAL && f->kind != JSON_NUMBER)) return false;
+        value = f->number != 0;
+        return true;
+    }
+
+    bool stringIs(const char* key, const char* expected) const {
+        const JsonField* f = field(key);
+        return f && f->kind == JSON_STRING && f->value.equals(expected);
+    }
+
+    JsonSpan getArray(const char* key) const {
+        const JsonField* f = field(key);
+        return f && f->kind == JSON_ARRAY ? f->value : JsonSpan();
+    }
+
+    // The "type" string, empty if missing
+    JsonSpan type() const {
+        const JsonField* f = field("type");
+        return f && f->kind == JSON_STRING ? f->value : JsonSpan();
+    }
+
+    uint8_t count = 0;
+    JsonField fields[MAX_FIELDS];
+};
+
+// Walks the elements of an array span ([2,3,[4,5]]) front to back
+class JsonArrayReader {
+public:
+    explicit JsonArrayReader(JsonSpan array)
+        : p(array.ptr ? array.ptr + 1 : nullptr), end(array.ptr ? array.ptr + array.len - 1 : nullptr) {}
+
+    // Next element if it is a number; other elements are skipped
+    bool nextNumber(long& value) {
+        JsonSpan element;
+        while (nextElement(element)) {
+            if (json_detail::parseNumber(element.ptr, element.ptr + element.len, value)) return true;
+        }
+        return false;
+    }
+
+    // Next element if it is an array; other elements are skipped
+    bool nextArray(JsonSpan& array) {
+        while (nextElement(array)) {
+            if (array.len >= 2 && array.ptr[0] == '[') return true;
+        }
+        return false;
+    }
+
+private:
+    bool nextElement(JsonSpan& element) {
+        using namespace json_detail;
+        if (!p) return false;
+        p = skipSpace(p, end);
+        if (p < end && *p == ',') p = skipSpace(p + 1, end);
+        if (p >= end) return false;
+
+        const char* start = p;
+        if (*p == '[' || *p == '{') {
+            p = skipNested(p, end);
+        } else if (*p == '"') {
+            p = skipString(p + 1, end);
+        } else {
+            while (p < end && *p != ',' && !isSpace(*p)) p++;
+        }
+        if (!p) return false;
+        element.ptr = start;
+        element.len = (uint16_t)(p - start);
+        return true;
+    }
+
+    const char* p;
+    const char* end;
+};
+
+// Fixed-capacity line collector. A line longer than the buffer is dropped
+// whole: the rest of it is discarded up to the next line ending instead of
+// being parsed as a fresh command.
+template <size_t N>
+class CommandLine {
+public:
+    // Add one received byte. Returns true when a line is complete.
+    bool append(char c) {
+        if (c == '\n' || c == '\r') {
+            bool complete = length > 0 && !overflow;
+            if (!complete) clear();
+            return complete;
+        }
+        if (overflow) return false;
+        if (length >= N) {
+            overflow = true;
+            length = 0;
+            overflowCount++;
+            return false;
+        }
+        buffer[length++] = c;
+        return false;
+    }
+
+    // The collected line, NUL-terminated
+    const char* c_str() {
+        buffer[length] = '\0';
+        return buffer;
+    }
+
+    size_t size() const { return length; }
+    bool empty() const { return length == 0; }
+
+    // Bytes received since the last line ending, kept or being discarded
+    bool pending() const { return length > 0 || overflow; }
+
+    void clear() {
+        length = 0;
+        overflow = false;
+    }
+
+    // Lines dropped for being too long
+    uint32_t overflows() const { return overflowCount; }
+
+private:
+    char buffer[N + 1];
+    size_t length = 0;
+    bool overflow = false;
+    uint32_t overflowCount = 0;
+};
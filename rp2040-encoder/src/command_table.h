@@ -0,0 +1,75 @@
+/**
+ * Compile-time perfect hash over a command table
+ *
+ * The command set is one constexpr array of entries with a `name` member.
+ * buildPerfectHash() searches, at compile time, for a hash seed that gives
+ * every name its own slot in a power-of-two table. A lookup is then one
+ * hash of the received name, one slot read and one string compare, however
+ * many commands there are. Adding a name that cannot be placed fails the
+ * build (static_assert on `valid`) rather than misrouting at runtime.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+namespace command_table {
+    // FNV-1a with the seed folded into the offset basis. The final shift
+    // brings the well-mixed high bits down to the slot bits.
+    constexpr uint32_t hash(const char* s, size_t len, uint32_t seed) {
+        uint32_t h = 2166136261u ^ seed;
+        for (size_t i = 0; i < len; i++) {
+            h = (h ^ (uint8_t)s[i]) * 16777619u;
+        }
+        return h ^ (h >> 16);
+    }
+
+    constexpr size_t length(const char* s) {
+        size_t n = 0;
+        while (s[n] != '\0') n++;
+        return n;
+    }
+}
+
+template <size_t SLOTS>
+struct PerfectHashIndex {
+    static_assert(SLOTS >= 2 && SLOTS <= 256 && (SLOTS & (SLOTS - 1)) == 0,
+                  "PerfectHashIndex size must be a power of two up to 256");
+
+    bool valid = false;
+    uint32_t seed = 0;
+    uint8_t slots[SLOTS] = {};      // Entry index + 1; 0 = empty
+
+    // Candidate entry index for a name, or -1. The caller still compares
+    // the name, since an unknown name can land on a used slot.
+    int find(const char* name, size_t len) const {
+        uint8_t slot = slots[command_table::hash(name, len, seed) & (SLOTS - 1)];
+        return (int)slot - 1;
+    }
+};
+
+template <size_t SLOTS, typename Entry, size_t N>
+constexpr PerfectHashIndex<SLOTS> buildPerfectHash(const Entry (&entries)[N]) {
+    static_assert(N < SLOTS, "Command table needs more hash slots");
+    for (uint32_t seed = 0; seed < 4096; seed++) {
+        PerfectHashIndex<SLOTS> index;
+        index.seed = seed;
+        bool collision = false;
+        for (size_t i = 0; i < N && !collision; i++) {
+            const char* name = entries[i].name;
+            uint32_t slot = command_table::hash(name, command_table::length(name), seed) & (SLOTS - 1);
+            if (index.slots[slot] != 0) {
+                collision = true;
+            } else {
+                index.slots[slot] = (uint8_t)(i + 1);
+            }
+        }
+        if (!collision) {
+            index.valid = true;
+            return index;
+        }
+    }
+    return PerfectHashIndex<SLOTS>();
+}
@@ -0,0 +1,120 @@
+/**
+ * Cycle counter and fixed-bucket histograms for the firmware profiler
+ *
+ * The Cortex-M0+ has no cycle counter of its own, so each core's SysTick
+ * is set free-running at the core clock: a 24-bit down-counter, read as an
+ * up-count here. One read is a single load, cheap enough for an ISR.
+ * Spans are taken modulo 2^24, so anything longer than 2^24 cycles (about
+ * 134 ms at 125 MHz) aliases. The native build derives a nominal
+ * 125 MHz count from the shim's virtual clock, so profiling costs the
+ * benchmarks only the histogram updates; spans within one loop pass read
+ * as 0 there.
+ *
+ * Histogram buckets are powers of two: bucket 0 holds 0, bucket i holds
+ * [2^(i-1), 2^i), and the last bucket holds everything from 2^23 up. The
+ * bucket comes from a byte-wise bit length table, as the M0+ has no CLZ.
+ *
+ * A histogram has one writer; another core may read it while it is being
+ * added to, which can leave that one sample half counted. clear() counts
+ * as a write: call it from the writer's context, or with the writer kept
+ * out (interrupts masked when the writer is a handler on that core).
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#if defined(ARDUINO_ARCH_RP2040)
+    #include <hardware/clocks.h>
+    #include <hardware/structs/systick.h>
+#else
+    #include <Arduino.h>
+#endif
+
+const uint32_t CYCLE_COUNTER_MASK = 0xFFFFFF;
+#if !defined(ARDUINO_ARCH_RP2040)
+const uint32_t NATIVE_CYCLES_PER_US = 125;
+#endif
+
+// Start the counter on the calling core (each core has its own SysTick)
+inline void startCycleCounter() {
+#if defined(ARDUINO_ARCH_RP2040)
+    systick_hw->csr = 0;
+    systick_hw->rvr = CYCLE_COUNTER_MASK;
+    systick_hw->cvr = 0;
+    systick_hw->csr = 0x5;          // Enable, core clock, no interrupt
+#endif
+}
+
+inline uint32_t cycleCount() {
+#if defined(ARDUINO_ARCH_RP2040)
+    return CYCLE_COUNTER_MASK - systick_hw->cvr;
+#else
+    return (uint32_t)micros() * NATIVE_CYCLES_PER_US & CYCLE_COUNTER_MASK;
+#endif
+}
+
+// Counter ticks per second
+inline uint32_t cycleCounterHz() {
+#if defined(ARDUINO_ARCH_RP2040)
+    return clock_get_hz(clk_sys);
+#else
+    return NATIVE_CYCLES_PER_US * 1000000u;
+#endif
+}
+
+inline uint32_t cyclesBetween(uint32_t start, uint32_t end) {
+    return (end - start) & CYCLE_COUNTER_MASK;
+}
+
+namespace cycle_profile_detail {
+    struct BitLengthTable {
+        uint8_t value[256];
+        constexpr BitLengthTable() : value() {
+            for (int i = 1; i < 256; i++) value[i] = (uint8_t)(value[i / 2] + 1);
+        }
+    };
+    constexpr BitLengthTable BIT_LENGTH;
+}
+
+class CycleHistogram {
+public:
+    static const size_t BUCKETS = 25;
+
+    static size_t bucketOf(uint32_t value) {
+        const uint8_t* bits = cycle_profile_detail::BIT_LENGTH.value;
+        size_t bucket;
+        if (value >> 16) {
+            bucket = value >> 24 ? 24 + bits[value >> 24] : 16 + bits[value >> 16];
+        } else {
+            bucket = value >> 8 ? 8 + bits[value >> 8] : bits[value];
+        }
+        return bucket < BUCKETS ? bucket : BUCKETS - 1;
+    }
+
+    void add(uint32_t value) {
+        size_t bucket = bucketOf(value);
+        counts[bucket] = counts[bucket] + 1;
+        samples = samples + 1;
+        sum = sum + value;
+        if (value > maximum) maximum = value;
+    }
+
+    void clear() {
+        for (size_t i = 0; i < BUCKETS; i++) counts[i] = 0;
+        samples = 0;
+        sum = 0;
+        maximum = 0;
+    }
+
+    uint32_t count() const { return samples; }
+    uint64_t total() const { return sum; }
+    uint32_t max() const { return maximum; }
+    uint32_t bucket(size_t i) const { return counts[i]; }
+
+private:
+    volatile uint32_t counts[BUCKETS] = {};
+    volatile uint32_t samples = 0;
+    volatile uint64_t sum = 0;
+    volatile uint32_t maximum = 0;
+};
@@ -0,0 +1,98 @@
+/**
+ * Vendor-defined USB HID report for HID builds (ENCODER_HID=1)
+ *
+ * The device exposes one vendor-page HID interface next to the CDC port,
+ * with a 1 ms interrupt IN endpoint. Each input report is a fixed 16-byte
+ * snapshot, little-endian, no report ID:
+ *
+ *   0      uint8   sequence, +1 per report (host detects missed reports)
+ *   1      uint8   flags (bit 0: buttons changed since the last report)
+ *   2..3   int16   clicks since the last report
+ *   4..7   int32   absolute count, low 32 bits (host unwraps)
+ *   8..9   int16   velocity, 0.1 counts/s, saturated
+ *   10..13 uint32  debounced button mask, bit n = GPn pressed
+ *   14..15 uint16  dial position within one revolution
+ *
+ * Pure data and packing, so the native build checks it too: a static_assert
+ * walks the descriptor and compares its input report size with the packer.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "binary_protocol.h"
+
+const size_t HID_REPORT_SIZE = 16;
+const uint8_t HID_POLL_INTERVAL_MS = 1;
+
+const uint8_t HID_FLAG_BUTTONS_CHANGED = 0x01;
+
+constexpr uint8_t HID_REPORT_DESCRIPTOR[] = {
+    0x06, 0x00, 0xFF,           // Usage Page (Vendor Defined 0xFF00)
+    0x09, 0x01,                 // Usage (Vendor 1: pendant)
+    0xA1, 0x01,                 // Collection (Application)
+    0x09, 0x02,                 //   Usage (Vendor 2: encoder report)
+    0x15, 0x00,                 //   Logical Minimum (0)
+    0x26, 0xFF, 0x00,           //   Logical Maximum (255)
+    0x75, 0x08,                 //   Report Size (8 bits)
+    0x95, (uint8_t)HID_REPORT_SIZE, //   Report Count (HID_REPORT_SIZE)
+    0x81, 0x02,                 //   Input (Data, Variable, Absolute)
+    0xC0,                       // End Collection
+};
+
+struct HidEncoderReport {
+    uint8_t sequence;
+    uint8_t flags;
+    int32_t delta;          // Saturated to int16 when packed
+    int32_t count;          // Low 32 bits of the absolute count
+    float velocity;         // counts/s
+    uint32_t buttons;
+    uint16_t position;
+};
+
+// Total input report bits declared by a descriptor (short items only)
+constexpr size_t hidInputReportBits(const uint8_t* desc, size_t len) {
+    size_t bits = 0;
+    size_t reportSize = 0;
+    size_t reportCount = 0;
+    size_t i = 0;
+    while (i < len) {
+        uint8_t prefix = desc[i];
+        size_t dataLen = (prefix & 0x03) == 3 ? 4 : (prefix & 0x03);
+        uint32_t value = 0;
+        for (size_t b = 0; b < dataLen && i + 1 + b < len; b++) {
+            value |= (uint32_t)desc[i + 1 + b] << (8 * b);
+        }
+        switch (prefix & 0xFC) {
+            case 0x74: reportSize = value; break;     // Report Size
+            case 0x94: reportCount = value; break;    // Report Count
+            case 0x80: bits += reportSize * reportCount; break;  // Input
+        }
+        i += 1 + dataLen;
+    }
+    return bits;
+}
+
+static_assert(hidInputReportBits(HID_REPORT_DESCRIPTOR, sizeof(HID_REPORT_DESCRIPTOR)) == HID_REPORT_SIZE * 8,
+              "HID descriptor input report does not match HID_REPORT_SIZE");
+
+// Pack a report into out[HID_REPORT_SIZE]
+inline void packHidReport(const HidEncoderReport& report, uint8_t* out) {
+    int32_t delta = report.delta;
+    if (delta > 32767) delta = 32767;
+    if (delta < -32767) delta = -32767;
+
+    float scaled = report.velocity * 10.0f;
+    if (scaled > 32767.0f) scaled = 32767.0f;
+    if (scaled < -32767.0f) scaled = -32767.0f;
+
+    out[0] = report.sequence;
+    out[1] = report.flags;
+    putLe16(out + 2, (uint16_t)(int16_t)delta);
+    putLe32(out + 4, (uint32_t)report.count);
+    putLe16(out + 8, (uint16_t)(int16_t)scaled);
+    putLe32(out + 10, report.buttons);
+    putLe16(out + 14, report.position);
+}
@@ -0,0 +1,105 @@
+/**
+ * Status LED effect scheduler
+ *
+ * Effects are layered; render() returns the colour for a point in time:
+ *   1. flashes   queued one after another (encoder, buttons)
+ *   2. pulse     a soft triangle ramp up and down (heartbeat)
+ *   3. state     steady background colour (machine state, set by the host)
+ *
+ * Queuing an effect only records it; nothing touches the LED until the
+ * caller renders, and the caller pushes the colour out only when it
+ * differs from the last one written. A flash of the colour already at the
+ * back of the queue extends it instead of queuing a new one, so a spinning
+ * wheel keeps the LED lit with a single write.
+ *
+ * Times are millis() values; comparisons survive wraparound.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+class LedEffects {
+public:
+    static const uint8_t MAX_FLASHES = 4;       // Further flashes are dropped
+    static const uint32_t PULSE_LEVELS = 8;     // Brightness steps per ramp
+
+    // Master switch; off renders black whatever is queued
+    void setEnabled(bool on) { enabled = on; }
+    bool isEnabled() const { return enabled; }
+
+    void setStateColor(uint32_t color) { stateColor = color; }
+    uint32_t getStateColor() const { return stateColor; }
+
+    void flash(uint32_t color, uint32_t durationMs, uint32_t nowMs) {
+        if (flashCount > 0) {
+            Flash& last = flashes[(flashHead + flashCount - 1) % MAX_FLASHES];
+            if (last.color == color) {
+                if (after(nowMs + durationMs, last.endMs)) last.endMs = nowMs + durationMs;
+                return;
+            }
+            if (flashCount == MAX_FLASHES) return;
+            // Starts when the one before it ends
+            flashes[(flashHead + flashCount) % MAX_FLASHES] = {color, last.endMs + durationMs};
+        } else {
+            flashes[flashHead] = {color, nowMs + durationMs};
+        }
+        flashCount++;
+    }
+
+    // Restarts any pulse in progress
+    void pulse(uint32_t color, uint32_t durationMs, uint32_t nowMs) {
+        pulseColor = color;
+        pulseStartMs = nowMs;
+        pulseDurationMs = durationMs;
+    }
+
+    uint32_t render(uint32_t nowMs) {
+        while (flashCount > 0 && !after(flashes[flashHead].endMs, nowMs)) {
+            flashHead = (flashHead + 1) % MAX_FLASHES;
+            flashCount--;
+        }
+        if (!enabled) return 0;
+        if (flashCount > 0) return flashes[flashHead].color;
+
+        if (pulseDurationMs > 0) {
+            uint32_t phase = nowMs - pulseStartMs;
+            if (phase < pulseDurationMs) {
+                // Up to full brightness at the midpoint and back down
+                uint32_t half = (pulseDurationMs + 1) / 2;
+                uint32_t rise = phase < half ? phase : pulseDurationMs - phase;
+                uint32_t level = 1 + rise * (PULSE_LEVELS - 1) / half;
+                return scale(pulseColor, level > PULSE_LEVELS ? PULSE_LEVELS : level);
+            }
+            pulseDurationMs = 0;
+        }
+        return stateColor;
+    }
+
+private:
+    struct Flash {
+        uint32_t color;
+        uint32_t endMs;
+    };
+
+    // a is later than b
+    static bool after(uint32_t a, uint32_t b) { return (int32_t)(a - b) > 0; }
+
+    static uint32_t scale(uint32_t color, uint32_t level) {
+        uint32_t r = ((color >> 16) & 0xFF) * level / PULSE_LEVELS;
+        uint32_t g = ((color >> 8) & 0xFF) * level / PULSE_LEVELS;
+        uint32_t b = (color & 0xFF) * level / PULSE_LEVELS;
+        return (r << 16) | (g << 8) | b;
+    }
+
+    bool enabled = true;
+    uint32_t stateColor = 0;
+
+    Flash flashes[MAX_FLASHES] = {};
+    uint8_t flashHead = 0;
+    uint8_t flashCount = 0;
+
+    uint32_t pulseColor = 0;
+    uint32_t pulseStartMs = 0;
+    uint32_t pulseDurationMs = 0;
+};
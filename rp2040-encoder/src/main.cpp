@@ -5,25 +5,64 @@
  * Supports: Raspberry Pi Pico, Waveshare RP2040-Zero, Pimoroni Tiny2040
  * Connect: Encoder A -> GP0, Encoder B -> GP1, GND -> GND
  * 
+ * Quadrature decoding runs in a PIO state machine (quadrature.pio) that
+ * counts every edge in hardware; loop() only samples the count. Boards or
+ * builds without PIO fall back to the CHANGE-interrupt decoder.
+ * 
+ * Input capture (decoder, buttons, timestamps) runs on core 1 in loop1();
+ * USB serial, LED and command handling run on core 0 in loop(). Captured
+ * events cross between the cores through lock-free rings (spsc_ring.h),
+ * so a blocking USB write or LED update never delays input sampling, and
+ * no path masks interrupts.
+ * 
+ * The status LED is driven by an effect scheduler (led_effects.h) that
+ * loop() renders last in each pass, writing only when the colour changes.
+ * On the RP2040-Zero the WS2812 bits are shifted out by a PIO state
+ * machine (ws2812.pio), so a write is a single FIFO store.
+ * 
  * Sends JSON messages over USB serial when encoder rotates:
- * {"type":"encoder","delta":1,"position":123}
+ * {"type":"encoder","delta":1,"position":23,"count":123,"velocity":42.5}
+ * (count: 64-bit absolute count; position: dial position within one
+ * revolution; velocity: filtered wheel speed in counts/s, from edge
+ * timestamps)
  * 
  * Button events:
  * {"type":"button","pin":2,"state":"pressed"}
  * {"type":"button","pin":2,"state":"released"}
+ * 
+ * The host can switch output to COBS-framed binary records with
+ * {"type":"protocol","mode":"binary"} (see binary_protocol.h). JSON stays
+ * the default so the firmware can be driven from a serial monitor.
  */
 
 #include <Arduino.h>
+#if defined(ARDUINO_ARCH_RP2040)
+    #include <hardware/gpio.h>
+    #include <pico/time.h>
+#endif
+#include "binary_protocol.h"
+#include "command_parser.h"
+#include "command_table.h"
+#include "cycle_profile.h"
+#include "hid_report.h"
+#include "led_effects.h"
+#include "message_writer.h"
+#include "replay_buffer.h"
+#include "seqlock.h"
+#include "spsc_ring.h"
+#include "velocity.h"
 
 // Board detection for LED type
 #if defined(BOARD_RP2040_ZERO)
-    // RP2040-Zero: WS2812 NeoPixel on GP16
-    #include <Adafruit_NeoPixel.h>
+    // RP2040-Zero: WS2812 NeoPixel on GP16, driven by a PIO state machine
+    #include "ws2812.pio.h"
     #define LED_TYPE_NEOPIXEL 1
     #define LED_TYPE_RGB 0
     #define LED_TYPE_SINGLE 0
     const uint8_t LED_PIN = 16;
-    Adafruit_NeoPixel led(1, LED_PIN, NEO_GRB + NEO_KHZ800);
+    const uint8_t LED_BRIGHTNESS = 30;  // Dim (0-255) - these LEDs are bright!
+    PIO ledPio = nullptr;               // PIO block running ws2812 (nullptr = not loaded)
+    uint ledSm = 0;
     const char* DEVICE_NAME = "RP2040-Zero";
 #elif defined(BOARD_TINY2040)
     // Tiny2040: RGB LED on GP18(R), GP19(G), GP20(B) - active LOW
@@ -44,50 +83,310 @@
     const char* DEVICE_NAME = "Pico";
 #endif
 
-// Encoder pins
+// Encoder pins (must be consecutive for the PIO decoder)
 const uint8_t PIN_A = 0;   // GP0
 const uint8_t PIN_B = 1;   // GP1
 
+// Quadrature decoder: PIO state machine on RP2040, CHANGE interrupts otherwise
+#ifndef ENCODER_USE_PIO
+    #if defined(ARDUINO_ARCH_RP2040)
+        #define ENCODER_USE_PIO 1
+    #else
+        #define ENCODER_USE_PIO 0
+    #endif
+#endif
+
+// Vendor HID report interface next to the CDC port (see hid_report.h).
+// Enabled per board by the *_hid environments in platformio.ini, which
+// switch the core to the TinyUSB stack.
+#ifndef ENCODER_HID
+    #define ENCODER_HID 0
+#endif
+
+#if ENCODER_HID
+    #include <Adafruit_TinyUSB.h>
+    Adafruit_USBD_HID usbHid;
+#endif
+
+#if ENCODER_USE_PIO
+    #include "quadrature.pio.h"
+    PIO encoderPio = nullptr;          // PIO block running the decoder (nullptr = ISR fallback)
+    uint encoderSm = 0;                // State machine index within encoderPio
+    int32_t lastPioCount = 0;          // Raw pulse count at the previous sample
+#endif
+
+// Input capture on core 1 (setup1/loop1) on RP2040. The core runs the
+// USB stack's interrupts on core 0, so keeping capture off that core is
+// what isolates it. Single-core builds run loop1() inline from loop().
+#if defined(ARDUINO_ARCH_RP2040)
+    #define DUAL_CORE 1
+#else
+    #define DUAL_CORE 0
+#endif
+
+void setup1();
+void loop1();
+bool drainInputEvents();
+void sendReady();
+void flashLed(uint32_t color, unsigned long durationMs);
+
 // ==================== BUTTON CONFIGURATION ====================
-const uint8_t MAX_BUTTONS = 12;
-const unsigned long DEBOUNCE_MS = 50;  // Debounce time in milliseconds
-
-struct ButtonState {
-    uint8_t pin;           // GPIO pin number (0 = not configured)
-    bool enabled;          // Is this button configured?
-    bool lastState;        // Last stable state (true = pressed, active LOW)
-    bool currentReading;   // Current raw reading
-    unsigned long lastDebounceTime;  // Last time the reading changed
-};
+const uint8_t MAX_BUTTONS = 28;        // Every GPIO but the encoder pins
+const unsigned long DEBOUNCE_MS = 50;  // Default debounce time in milliseconds
+const unsigned long DEBOUNCE_MAX_MS = 200;
+const uint8_t DEBOUNCE_SAMPLES = 4;    // Equal samples needed to accept a change
+
+// Debouncer, owned by the input core. All button pins share one edge
+// interrupt that starts a periodic sampling alarm. Each sample reads the
+// whole GPIO bank once (gpio_get_all) and steps a 2-bit vertical counter
+// per pin, so a tick costs the same for one button or MAX_BUTTONS. The
+// alarm stops once every pin agrees with its debounced state, so idle
+// buttons cost nothing. The edge interrupt and the alarm run at the same
+// priority on the input core and never preempt each other.
+uint32_t buttonPinMask = 0;            // Configured pins
+uint32_t buttonState = 0;              // Debounced state (1 = pressed, active LOW)
+uint32_t buttonCount0 = ~0u;           // Vertical counter, low bit per pin
+uint32_t buttonCount1 = ~0u;           // Vertical counter, high bit per pin
+volatile bool buttonSampling = false;
+alarm_pool_t* buttonAlarmPool = nullptr;   // Created on the input core
+alarm_id_t buttonAlarmId = 0;
 
-ButtonState buttons[MAX_BUTTONS];
+// Sample period, set by the protocol core with {"type":"debounce","ms":N}
+volatile uint32_t buttonTickUs = DEBOUNCE_MS * 1000 / DEBOUNCE_SAMPLES;
+
+// Requested configuration, owned by the protocol core. Edits are bracketed
+// by buttonConfigSeq going odd/even; the input core copies the pins only
+// when the sequence is even and unchanged across the copy.
+uint8_t buttonConfigPins[MAX_BUTTONS];  // 0 = slot unused
+uint32_t buttonConfigSeq = 0;
+uint32_t appliedButtonConfigSeq = 0;   // Input core: last sequence applied
 uint8_t numConfiguredButtons = 0;
 
+// Button reporting (protocol core). Edge mode sends one message per pin
+// change; snapshot mode sends the whole mask once per change, so buttons
+// that settle together reach the host together.
+// Switched with {"type":"buttons_mode","mode":"snapshot"|"edges"}.
+bool buttonSnapshotMode = false;
+uint32_t reportedButtonMask = 0;       // Mask as last reported
+
+// Chords: sets of pins reported as one event once all are held, set with
+// {"type":"chords","chords":[[2,5],[2,6]]}. The pins whose press completes
+// a chord are consumed by it: in edge mode their press and later release
+// are not reported on their own, so FN+X reaches the host as just the FN
+// press and the chord.
+const uint8_t MAX_CHORDS = 8;
+uint32_t chordMasks[MAX_CHORDS];
+uint8_t numChords = 0;
+uint8_t activeChords = 0;              // Bit per chord currently held
+uint32_t chordConsumedPins = 0;
+
+// ==================== CORE HANDOFF ====================
+
+// Input events, stamped with micros() where they are captured
+const uint8_t EVT_CLICKS = 1;   // value = captured click count after this click
+const uint8_t EVT_BUTTONS = 2;  // value = debounced button mask (bit n = GPIO n)
+
+struct InputEvent {
+    uint32_t micros;       // Capture time
+    int32_t value;
+    uint8_t type;
+    uint8_t pin;
+};
+
+// One ring per producer: the encoder decoder (ISR, or loop1() with the PIO
+// decoder) and the button sampling alarm. Both drain on the protocol core.
+SpscRing<InputEvent, 64> clickEvents;
+SpscRing<InputEvent, 16> buttonEvents;
+
+// Latest captured click count, readable from any core. Click events carry
+// the count rather than a delta, so one dropped on overflow only delays
+// its clicks: the protocol core catches up from this snapshot once the
+// ring is empty and the count has settled for CLICK_CATCHUP_US.
+struct EncoderSnapshot {
+    int32_t clicks;
+    uint32_t micros;       // Capture time of the latest click
+};
+
+Seqlock<EncoderSnapshot> encoderSnapshot;
+const uint32_t CLICK_CATCHUP_US = 1000;
+
+// Loop accounting per core, reported by {"type":"cores"}
+struct CoreStats {
+    volatile uint32_t passes;       // Loop passes
+    volatile uint32_t busyPasses;   // Passes that did any work
+    volatile uint32_t busyUs;       // Time spent in those passes
+    volatile uint32_t maxPassUs;    // Longest single pass
+};
+
+CoreStats coreStats[2];
+
+// Cycle profile, reported and cleared by {"type":"stats"}: the encoder
+// decoder (the ISR's time and call interval, or the PIO poll), the button
+// edge interrupt and debounce alarm, each core's loop pass, and the phases
+// of the protocol core's pass. Each histogram is written by one core;
+// core 1's are cleared there on request.
+enum ProfileSlot {
+    PROF_ENCODER_ISR,       // Core 1, interrupt decoder only
+    PROF_ISR_INTERVAL,      // Core 1, microseconds, interrupt decoder only
+    PROF_POLL_ENCODER,      // Core 1, PIO decoder only
+    PROF_BUTTON_ISR,        // Core 1
+    PROF_BUTTON_SAMPLE,     // Core 1
+    PROF_LOOP1,             // Core 1
+    PROF_LOOP,              // Core 0 from here on
+    PROF_INPUT,
+    PROF_DELIVER,
+    PROF_REPORT,
+    PROF_HEARTBEAT,
+    PROF_BENCH,
+    PROF_STATS,             // Sending a stats reply, kept apart from what it measures
+    PROF_COMMANDS,
+    PROF_HID,
+    PROF_FLUSH,
+    PROF_LED,
+    PROF_COUNT
+};
+
+const char* const PROFILE_NAMES[PROF_COUNT] = {
+    "encoderIsr", "isrInterval", "pollEncoder", "buttonIsr", "buttonSample", "loop1",
+    "loop", "input", "deliver", "report", "heartbeat", "bench", "stats", "commands",
+    "hid", "flush", "led"
+};
+
+CycleHistogram profile[PROF_COUNT];
+uint32_t profileSinceMicros = 0;
+volatile bool profileResetRequested = false;    // Core 1 histograms, set by core 0
+uint32_t lastEncoderIsrMicros = 0;
+bool encoderIsrSeen = false;
+int profileReplyNext = -1;      // Stats reply being sent: next slot, PROF_COUNT for the summary, -1 idle
+
 // ==============================================================
 
 // LED colors
 const uint32_t COLOR_OFF = 0x000000;
 const uint32_t COLOR_GREEN = 0x00FF00;   // Encoder movement
 const uint32_t COLOR_BLUE = 0x0000FF;    // Heartbeat
-const uint32_t COLOR_RED = 0xFF0000;     // Startup
+const uint32_t COLOR_RED = 0xFF0000;     // Startup, alarm
+const uint32_t COLOR_CYAN = 0x00FFFF;    // Running
+const uint32_t COLOR_AMBER = 0xFFA000;   // Hold, door
+const uint32_t COLOR_MAGENTA = 0xFF00FF; // Homing
+const uint32_t COLOR_WHITE = 0xFFFFFF;   // Check mode
+
+// Machine-state background colours, by GRBL state name (host sets the state)
+struct LedStateColor {
+    const char* state;
+    uint32_t color;
+};
+const LedStateColor LED_STATE_COLORS[] = {
+    {"idle",  COLOR_OFF},
+    {"run",   COLOR_CYAN},
+    {"jog",   COLOR_CYAN},
+    {"home",  COLOR_MAGENTA},
+    {"hold",  COLOR_AMBER},
+    {"door",  COLOR_AMBER},
+    {"alarm", COLOR_RED},
+    {"check", COLOR_WHITE},
+    {"sleep", COLOR_OFF},
+};
+
+// LED state. Effects are queued in ledEffects and rendered at the end of
+// loop(); the LED is written only when the rendered colour changes.
+LedEffects ledEffects;
+uint32_t ledShownColor = COLOR_OFF;
+uint32_t ledLastWriteUs = 0;
+const uint32_t LED_MIN_WRITE_US = 1000;  // WS2812 latches after >280us idle
+const unsigned long HEARTBEAT_PULSE_MS = 200;
+
+// Encoder resolution, set with {"type":"resolution","ppr":100,"decode":1}.
+// ppr is detents per revolution; decode is counts per detent: x1 counts
+// once per quadrature cycle (one click), x2 every other edge, x4 every edge.
+const uint16_t DEFAULT_PPR = 100;
+const uint16_t MAX_PPR = 10000;
+uint16_t encoderPpr = DEFAULT_PPR;
+uint8_t encoderDecode = 1;
+volatile uint8_t edgesPerCount = 4;     // 4 / encoderDecode, read by the decoder
+
+// Encoder capture state, owned by the decoder (ISR or PIO poll)
+int8_t lastEncoded = 0;
+int accumulatedPulses = 0;              // Raw pulses (edgesPerCount per count)
+int32_t capturedClicks = 0;             // Unwrapped count as captured (wraps at 32 bits)
+volatile bool pulseResetRequested = false;  // Set by "reset", cleared by the decoder
 
-// LED state
-unsigned long ledOffTime = 0;
+// Encoder report state (protocol core). The absolute count is 64-bit and
+// never wraps, so a host that missed messages can always resynchronise;
+// the dial position and revolutions are kept alongside it incrementally.
+int64_t encoderCount = 0;               // Absolute count since power-up or reset
+uint32_t encoderDialPosition = 0;       // encoderCount mod countsPerRev()
+int64_t encoderRevolutions = 0;         // encoderCount div countsPerRev(), rounded down
+int accumulatedClicks = 0;              // Counts to send
+uint32_t accumulatedSince = 0;         // Capture time of the oldest of them
+int32_t totalClicks = 0;                // capturedClicks as last applied (velocity input)
 
-// Encoder state (volatile for ISR access)
-volatile long encoderPosition = 0;      // Position in physical clicks
-volatile int8_t lastEncoded = 0;
-volatile int accumulatedPulses = 0;     // Raw pulses (4 per click)
-volatile int accumulatedClicks = 0;     // Clicks to send (after /4)
+// Velocity filter, fed with the capture timestamps of click events
+VelocityEstimator velocityEstimator;
 
 // Timing
 unsigned long lastSendTime = 0;
 unsigned long lastHeartbeatTime = 0;
-const unsigned long SEND_INTERVAL_MS = 50;      // 20Hz update rate for encoder data
+
+// Adaptive encoder reporting: the first click after a pause goes out at
+// once; while clicks keep coming the interval doubles from the minimum up
+// to the maximum, coalescing them. An empty send slot means the wheel
+// paused and drops the interval back to the minimum.
+// Host-settable with {"type":"report","minMs":2,"maxMs":50}.
+unsigned long reportMinMs = 2;
+unsigned long reportMaxMs = 50;                 // 20Hz under a sustained spin
+unsigned long reportIntervalMs = 2;             // Current interval
+const unsigned long REPORT_LIMIT_MS = 1000;
 const unsigned long HEARTBEAT_INTERVAL_MS = 2000; // Heartbeat every 2 seconds
 
-// Command buffer
-String inputBuffer = "";
+// Output protocol: JSON lines by default, binary records once the host opts in.
+// Reverts to JSON when the host closes the port (DTR low).
+bool binaryMode = false;
+
+// Event transport: once the host asks for HID ({"type":"transport"}),
+// encoder and button events go out as HID reports only and serial carries
+// replies, chords and heartbeats. Reverts with the port like binaryMode.
+bool hidEvents = false;
+int32_t hidPendingClicks = 0;          // Clicks not yet in a report
+bool hidButtonsChanged = false;
+bool hidReportDue = false;
+uint8_t hidSequence = 0;
+
+// Event delivery. Encoder, button and chord messages carry a sequence
+// number and are kept in eventHistory after they are sent. They queue
+// there while the port is closed (DTR low) or the host stops reading, and
+// go out in order once it can take them. A host that sees a gap asks for
+// {"type":"resend","from":N}; if those events are gone it gets a
+// {"type":"resync"} with the current count and buttons instead.
+enum EventType : uint8_t {
+    EVENT_ENCODER,
+    EVENT_BUTTON,
+    EVENT_BUTTON_STATE,
+    EVENT_CHORD,
+};
+
+struct OutputEvent {
+    uint8_t type;
+    uint8_t id;            // Button pin or chord id
+    bool pressed;
+    int32_t delta;
+    uint32_t position;     // Dial position
+    uint32_t mask;         // Button mask (snapshot)
+    uint32_t changed;
+    uint32_t micros;       // Capture time (snapshot, chord; encoder: first click)
+    int64_t count;
+    float velocity;
+};
+
+const uint32_t EVENT_HISTORY = 64;
+ReplayBuffer<OutputEvent, EVENT_HISTORY> eventHistory;
+uint32_t resendRequests = 0;           // Gaps reported by the host
+uint32_t resyncReplies = 0;            // Gaps too old to replay
+uint32_t eventStalls = 0;              // Deliveries held back by a host not reading
+
+// Command buffer (fixed size; an overlong line is dropped whole)
+const size_t COMMAND_LINE_MAX = 256;
+CommandLine<COMMAND_LINE_MAX> commandLine;
 unsigned long lastCharTime = 0;
 const unsigned long COMMAND_TIMEOUT_MS = 100;  // Process after 100ms of no input
 
@@ -113,8 +412,40 @@ const int8_t ENCODER_TABLE[16] = {
      0   // 11 -> 11: no change
 };
 
-// Interrupt handler for encoder
+// Fold raw pulses (ENCODER_TABLE direction) into captured clicks and
+// publish them. Shared by the interrupt decoder (one pulse at a time) and
+// the PIO decoder (any number of pulses since the last sample).
+void accumulatePulses(int32_t pulses) {
+    // A reset drops the partial click in progress
+    if (pulseResetRequested) {
+        accumulatedPulses = 0;
+        pulseResetRequested = false;
+    }
+    
+    // Invert direction and accumulate raw pulses
+    accumulatedPulses -= pulses;
+    
+    // Convert to counts (4 pulses = 1 physical click at x1). Division
+    // truncates toward zero, so a partial count keeps its sign in
+    // accumulatedPulses.
+    int edges = edgesPerCount;
+    int clicks = accumulatedPulses / edges;
+    if (clicks != 0) {
+        accumulatedPulses -= clicks * edges;
+        capturedClicks += clicks;
+        
+        // Push before publishing the count, so the catch-up never runs
+        // ahead of an event still on its way into the ring
+        uint32_t now = micros();
+        InputEvent event = {now, capturedClicks, EVT_CLICKS, 0};
+        clickEvents.push(event);
+        encoderSnapshot.store({capturedClicks, now});
+    }
+}
+
+// Interrupt handler for encoder (fallback when the PIO decoder is unavailable)
 void encoderISR() {
+    uint32_t start = cycleCount();
     uint8_t a = digitalRead(PIN_A);
     uint8_t b = digitalRead(PIN_B);
     int8_t encoded = (a << 1) | b;
@@ -123,54 +454,419 @@ void encoderISR() {
     int8_t delta = ENCODER_TABLE[index];
     
     if (delta != 0) {
-        // Invert direction and accumulate raw pulses
-        accumulatedPulses -= delta;
-        
-        // Convert to clicks (4 pulses = 1 physical click)
-        while (accumulatedPulses >= 4) {
-            accumulatedPulses -= 4;
-            encoderPosition = (encoderPosition + 1) % 100;
-            accumulatedClicks++;
-        }
-        while (accumulatedPulses <= -4) {
-            accumulatedPulses += 4;
-            encoderPosition = (encoderPosition + 99) % 100;  // +99 mod 100 = -1
-            accumulatedClicks--;
-        }
+        accumulatePulses(delta);
     }
     
     lastEncoded = encoded;
+    
+    uint32_t now = micros();
+    if (encoderIsrSeen) {
+        profile[PROF_ISR_INTERVAL].add(now - lastEncoderIsrMicros);
+    }
+    lastEncoderIsrMicros = now;
+    encoderIsrSeen = true;
+    profile[PROF_ENCODER_ISR].add(cyclesBetween(start, cycleCount()));
 }
 
-void sendEncoderData(int delta, long position) {
-    Serial.print("{\"type\":\"encoder\",\"delta\":");
-    Serial.print(delta);
-    Serial.print(",\"position\":");
-    Serial.print(position);
-    Serial.println("}");
+#if ENCODER_USE_PIO
+// Load the decoder into a free state machine. The jump table needs the
+// program at offset 0, so try pio1 first (the LED transmitter prefers pio0).
+bool beginPioEncoder() {
+    PIO candidates[] = {pio1, pio0};
+    for (PIO pio : candidates) {
+        if (!pio_can_add_program_at_offset(pio, &quadrature_encoder_program, 0)) continue;
+        int sm = pio_claim_unused_sm(pio, false);
+        if (sm < 0) continue;
+        
+        pio_add_program_at_offset(pio, &quadrature_encoder_program, 0);
+        quadrature_encoder_program_init(pio, sm, PIN_A);
+        encoderPio = pio;
+        encoderSm = sm;
+        lastPioCount = quadrature_encoder_get_count(pio, sm);
+        return true;
+    }
+    return false;
 }
+#endif
 
-void sendPong(long position) {
-    Serial.print("{\"type\":\"pong\",\"position\":");
-    Serial.print(position);
-    Serial.println("}");
+// Sample the hardware pulse counter (no-op for the interrupt decoder)
+bool pollEncoder() {
+#if ENCODER_USE_PIO
+    if (encoderPio == nullptr) return false;
+    
+    uint32_t start = cycleCount();
+    int32_t count = quadrature_encoder_get_count(encoderPio, encoderSm);
+    int32_t delta = (int32_t)((uint32_t)count - (uint32_t)lastPioCount);
+    lastPioCount = count;
+    
+    if (delta != 0) {
+        accumulatePulses(delta);
+    }
+    profile[PROF_POLL_ENCODER].add(cyclesBetween(start, cycleCount()));
+    return delta != 0;
+#else
+    return false;
+#endif
 }
 
-void sendReady() {
-    Serial.print("{\"type\":\"ready\",\"device\":\"");
-    Serial.print(DEVICE_NAME);
-    Serial.print("\",\"encoder\":\"100PPR\",\"maxButtons\":");
-    Serial.print(MAX_BUTTONS);
-    Serial.println(",\"pins\":{\"a\":0,\"b\":1}}");
+// Which decoder is counting: the PIO program, or encoderISR() when the
+// build leaves it out or no state machine was free
+bool pioDecoderActive() {
+#if ENCODER_USE_PIO
+    return encoderPio != nullptr;
+#else
+    return false;
+#endif
+}
+
+uint32_t countsPerRev() {
+    return (uint32_t)encoderPpr * encoderDecode;
+}
+
+// Set the absolute count and derive the dial position and revolutions
+// from it (the one place that needs 64-bit division)
+void setEncoderCount(int64_t count) {
+    int64_t perRev = countsPerRev();
+    encoderCount = count;
+    encoderRevolutions = count / perRev;
+    int64_t position = count - encoderRevolutions * perRev;
+    if (position < 0) {
+        position += perRev;
+        encoderRevolutions--;
+    }
+    encoderDialPosition = (uint32_t)position;
+}
+
+// Advance the count; the dial position stays within one revolution
+void advanceEncoderCount(int32_t counts) {
+    int32_t perRev = (int32_t)countsPerRev();
+    int32_t position = (int32_t)encoderDialPosition + counts % perRev;
+    int32_t revolutions = counts / perRev;
+    if (position < 0) {
+        position += perRev;
+        revolutions--;
+    } else if (position >= perRev) {
+        position -= perRev;
+        revolutions++;
+    }
+    encoderCount += counts;
+    encoderDialPosition = (uint32_t)position;
+    encoderRevolutions += revolutions;
+}
+
+// Current filtered velocity in counts/s
+float currentVelocity() {
+    return velocityEstimator.velocity(micros());
+}
+
+// Every message goes to Serial in exactly one write. Input events are
+// flushed right after it, so they never wait behind a partly filled USB
+// packet. Replies and heartbeats only mark output pending; loop() flushes
+// once at the end of the pass.
+enum FlushPolicy : uint8_t {
+    FLUSH_NOW,
+    FLUSH_END_OF_PASS,
+};
+bool outputFlushPending = false;
+
+// Longest JSON event line (encoder with every field at its widest)
+typedef MessageWriter<176> LineWriter;
+
+void writeMessage(const void* data, size_t len, FlushPolicy policy) {
+    Serial.write((const uint8_t*)data, len);
+    if (policy == FLUSH_NOW) {
+        Serial.flush();
+        outputFlushPending = false;
+    } else {
+        outputFlushPending = true;
+    }
+}
+
+template <size_t N>
+void writeLine(const MessageWriter<N>& line, FlushPolicy policy) {
+    writeMessage(line.data(), line.size(), policy);
+}
+
+// Flush output left pending by FLUSH_END_OF_PASS messages
+bool flushOutput() {
+    if (!outputFlushPending) return false;
+    Serial.flush();
+    outputFlushPending = false;
+    return true;
+}
+
+// Frame a record (with 2 spare bytes for the CRC) and send it in one write
+void sendRecord(uint8_t* record, size_t len, FlushPolicy policy = FLUSH_NOW) {
+    uint8_t frame[framedSize(MAX_RECORD_SIZE)];
+    size_t n = frameRecord(record, len, frame);
+    writeMessage(frame, n, policy);
+}
+
+// Send a JSON reply line, wrapped in a text record in binary mode
+void sendText(const char* json, size_t len) {
+    if (!binaryMode) {
+        MessageWriter<MAX_RECORD_SIZE + 2> line;
+        line.raw(json, len).endLine();
+        writeLine(line, FLUSH_END_OF_PASS);
+        return;
+    }
+    uint8_t record[MAX_RECORD_SIZE + 2];
+    if (len > MAX_RECORD_SIZE - 1) len = MAX_RECORD_SIZE - 1;
+    record[0] = REC_TEXT;
+    memcpy(record + 1, json, len);
+    sendRecord(record, len + 1, FLUSH_END_OF_PASS);
+}
+
+void sendText(const char* json) {
+    sendText(json, strlen(json));
+}
+
+// Room for a whole message: events are never written partially or into a
+// closed port; they wait in eventHistory instead
+bool canWrite(size_t len) {
+    return Serial && Serial.availableForWrite() >= (int)len;
+}
+
+// sendText() if the whole reply fits now, for replies that may wait
+bool sendTextIfRoom(const char* json, size_t len) {
+    size_t n = binaryMode ? framedSize(len + 1) : len + 2;
+    if (!canWrite(n)) return false;
+    sendText(json, len);
+    return true;
+}
+
+// Frame a record and write it if it fits (events only)
+bool writeEventRecord(uint8_t* record, size_t len) {
+    uint8_t frame[framedSize(MAX_RECORD_SIZE)];
+    size_t n = frameRecord(record, len, frame);
+    if (!canWrite(n)) return false;
+    writeMessage(frame, n, FLUSH_NOW);
+    return true;
+}
+
+bool writeEventLine(const LineWriter& line) {
+    if (!canWrite(line.size())) return false;
+    writeLine(line, FLUSH_NOW);
+    return true;
+}
+
+bool writeEncoderEvent(uint32_t seq, const OutputEvent& e) {
+    if (binaryMode) {
+        // Velocity in 0.1 counts/s, saturated to int16
+        float scaled = e.velocity * 10.0f;
+        if (scaled > 32767.0f) scaled = 32767.0f;
+        if (scaled < -32767.0f) scaled = -32767.0f;
+        
+        uint8_t record[REC_ENCODER_SIZE + 2];
+        record[0] = REC_ENCODER;
+        putLe16(record + 1, (uint16_t)e.delta);
+        putLe32(record + 3, e.position);
+        putLe16(record + 7, (uint16_t)(int16_t)scaled);
+        putLe64(record + 9, (uint64_t)e.count);
+        putLe32(record + 17, e.micros);
+        putLe32(record + 21, micros());
+        putLe32(record + 25, seq);
+        return writeEventRecord(record, REC_ENCODER_SIZE);
+    }
+    LineWriter line;
+    line.str("{\"type\":\"encoder\",\"seq\":").u32(seq)
+        .str(",\"delta\":").i32(e.delta)
+        .str(",\"position\":").u32(e.position)
+        .str(",\"count\":").i64(e.count)
+        .str(",\"velocity\":").fixed1(e.velocity)
+        .str(",\"t\":").u32(e.micros)
+        .str(",\"tx\":").u32(micros())
+        .chr('}').endLine();
+    return writeEventLine(line);
+}
+
+bool writeButtonEvent(uint32_t seq, const OutputEvent& e) {
+    if (binaryMode) {
+        uint8_t record[REC_BUTTON_SIZE + 2];
+        record[0] = REC_BUTTON;
+        record[1] = e.id;
+        record[2] = e.pressed ? 1 : 0;
+        putLe32(record + 3, seq);
+        return writeEventRecord(record, REC_BUTTON_SIZE);
+    }
+    LineWriter line;
+    line.str("{\"type\":\"button\",\"seq\":").u32(seq)
+        .str(",\"pin\":").u32(e.id)
+        .str(e.pressed ? ",\"state\":\"pressed\"}" : ",\"state\":\"released\"}").endLine();
+    return writeEventLine(line);
+}
+
+bool writeButtonSnapshot(uint32_t seq, const OutputEvent& e) {
+    if (binaryMode) {
+        uint8_t record[REC_BUTTON_STATE_SIZE + 2];
+        record[0] = REC_BUTTON_STATE;
+        putLe32(record + 1, e.mask);
+        putLe32(record + 5, e.changed);
+        putLe32(record + 9, e.micros);
+        putLe32(record + 13, seq);
+        return writeEventRecord(record, REC_BUTTON_STATE_SIZE);
+    }
+    LineWriter line;
+    line.str("{\"type\":\"button_state\",\"seq\":").u32(seq)
+        .str(",\"mask\":").u32(e.mask)
+        .str(",\"changed\":").u32(e.changed)
+        .str(",\"t\":").u32(e.micros)
+        .chr('}').endLine();
+    return writeEventLine(line);
+}
+
+bool writeChordEvent(uint32_t seq, const OutputEvent& e) {
+    if (binaryMode) {
+        uint8_t record[REC_CHORD_SIZE + 2];
+        record[0] = REC_CHORD;
+        record[1] = e.id;
+        record[2] = e.pressed ? 1 : 0;
+        putLe32(record + 3, e.micros);
+        putLe32(record + 7, seq);
+        return writeEventRecord(record, REC_CHORD_SIZE);
+    }
+    LineWriter line;
+    line.str("{\"type\":\"chord\",\"seq\":").u32(seq)
+        .str(",\"id\":").u32(e.id)
+        .str(e.pressed ? ",\"state\":\"pressed\",\"t\":" : ",\"state\":\"released\",\"t\":").u32(e.micros)
+        .chr('}').endLine();
+    return writeEventLine(line);
+}
+
+bool writeEvent(uint32_t seq, const OutputEvent& e) {
+    switch (e.type) {
+        case EVENT_ENCODER:      return writeEncoderEvent(seq, e);
+        case EVENT_BUTTON:       return writeButtonEvent(seq, e);
+        case EVENT_BUTTON_STATE: return writeButtonSnapshot(seq, e);
+        case EVENT_CHORD:        return writeChordEvent(seq, e);
+    }
+    return true;
+}
+
+// Write queued events in order until the host has no room. Returns true
+// if any went out.
+bool deliverEvents() {
+    if (!Serial) return false;      // Port closed: keep them until it opens
+    bool worked = false;
+    uint32_t seq;
+    OutputEvent event;
+    while (eventHistory.peek(seq, event)) {
+        if (!writeEvent(seq, event)) {
+            eventStalls++;
+            break;
+        }
+        eventHistory.delivered();
+        worked = true;
+    }
+    return worked;
+}
+
+void queueEvent(const OutputEvent& event) {
+    eventHistory.append(event);
+    deliverEvents();
+}
+
+void sendEncoderData(int delta, uint32_t position, int64_t count, float velocity, uint32_t captureMicros) {
+    OutputEvent e = {};
+    e.type = EVENT_ENCODER;
+    e.micros = captureMicros;
+    e.delta = delta;
+    e.position = position;
+    e.count = count;
+    e.velocity = velocity;
+    queueEvent(e);
+}
+
+void sendPong(uint32_t position, int64_t count) {
+    if (binaryMode) {
+        uint8_t record[REC_PONG_SIZE + 2];
+        record[0] = REC_PONG;
+        putLe32(record + 1, position);
+        putLe64(record + 5, (uint64_t)count);
+        putLe32(record + 13, micros());
+        sendRecord(record, REC_PONG_SIZE);
+        return;
+    }
+    LineWriter line;
+    line.str("{\"type\":\"pong\",\"position\":").u32(position)
+        .str(",\"count\":").i64(count)
+        .str(",\"t\":").u32(micros()).chr('}').endLine();
+    writeLine(line, FLUSH_NOW);
 }
 
 // Send button state change
 void sendButtonEvent(uint8_t pin, bool pressed) {
-    Serial.print("{\"type\":\"button\",\"pin\":");
-    Serial.print(pin);
-    Serial.print(",\"state\":\"");
-    Serial.print(pressed ? "pressed" : "released");
-    Serial.println("\"}");
+    OutputEvent e = {};
+    e.type = EVENT_BUTTON;
+    e.id = pin;
+    e.pressed = pressed;
+    queueEvent(e);
+}
+
+// Send the full button mask after a change (snapshot mode)
+void sendButtonSnapshot(uint32_t mask, uint32_t changed, uint32_t captureMicros) {
+    OutputEvent e = {};
+    e.type = EVENT_BUTTON_STATE;
+    e.mask = mask;
+    e.changed = changed;
+    e.micros = captureMicros;
+    queueEvent(e);
+}
+
+// Send a chord becoming complete or broken
+void sendChordEvent(uint8_t id, bool pressed, uint32_t captureMicros) {
+    OutputEvent e = {};
+    e.type = EVENT_CHORD;
+    e.id = id;
+    e.pressed = pressed;
+    e.micros = captureMicros;
+    queueEvent(e);
+}
+
+// Report a new debounced button mask from the input core
+void handleButtonSnapshot(uint32_t mask, uint32_t captureMicros) {
+    uint32_t changed = mask ^ reportedButtonMask;
+    if (changed == 0) return;
+    reportedButtonMask = mask;
+    
+    // Releases of consumed pins belong to their chord
+    uint32_t released = changed & ~mask;
+    uint32_t suppressed = released & chordConsumedPins;
+    chordConsumedPins &= ~released;
+    
+    for (uint8_t i = 0; i < numChords; i++) {
+        uint8_t bit = 1 << i;
+        bool complete = (mask & chordMasks[i]) == chordMasks[i];
+        if (complete && !(activeChords & bit)) {
+            activeChords |= bit;
+            uint32_t completing = chordMasks[i] & changed & mask & ~chordConsumedPins;
+            chordConsumedPins |= completing;
+            suppressed |= completing;
+            sendChordEvent(i, true, captureMicros);
+        } else if (!complete && (activeChords & bit)) {
+            activeChords &= ~bit;
+            sendChordEvent(i, false, captureMicros);
+        }
+    }
+    
+    if (hidEvents) {
+        hidButtonsChanged = true;
+        hidReportDue = true;
+    } else if (buttonSnapshotMode) {
+        sendButtonSnapshot(mask, changed, captureMicros);
+    } else {
+        uint32_t report = changed & ~suppressed;
+        while (report != 0) {
+            uint8_t pin = __builtin_ctz(report);
+            report &= report - 1;
+            sendButtonEvent(pin, (mask >> pin) & 1);
+        }
+    }
+    
+    // Flash LED on button press
+    if (changed & mask) {
+        flashLed(COLOR_GREEN, 50);
+    }
 }
 
 // Check if a pin is reserved (encoder or LED pins)
@@ -189,6 +885,16 @@ bool isPinReserved(uint8_t pin) {
     return false;
 }
 
+// Bracket an edit of buttonConfigPins (protocol core)
+void beginButtonConfigEdit() {
+    __atomic_store_n(&buttonConfigSeq, buttonConfigSeq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+void endButtonConfigEdit() {
+    __atomic_store_n(&buttonConfigSeq, buttonConfigSeq + 1, __ATOMIC_RELEASE);
+}
+
 // Configure a button on a specific pin
 void configureButton(uint8_t index, uint8_t pin) {
     if (index >= MAX_BUTTONS) return;
@@ -196,23 +902,253 @@ void configureButton(uint8_t index, uint8_t pin) {
     // Don't allow reserved pins
     if (isPinReserved(pin)) return;
     
-    buttons[index].pin = pin;
-    buttons[index].enabled = true;
-    buttons[index].lastState = false;
-    buttons[index].currentReading = false;
-    buttons[index].lastDebounceTime = 0;
-    
-    // Configure pin with internal pull-up (button connects to GND)
-    pinMode(pin, INPUT_PULLUP);
+    beginButtonConfigEdit();
+    buttonConfigPins[index] = pin;
+    endButtonConfigEdit();
 }
 
 // Clear all button configurations
 void clearButtons() {
+    beginButtonConfigEdit();
     for (uint8_t i = 0; i < MAX_BUTTONS; i++) {
-        buttons[i].enabled = false;
-        buttons[i].pin = 0;
+        buttonConfigPins[i] = 0;
     }
+    endButtonConfigEdit();
     numConfiguredButtons = 0;
+    
+    // The input core restarts every button from released
+    drainInputEvents();
+    reportedButtonMask = 0;
+    activeChords = 0;
+    chordConsumedPins = 0;
+}
+
+int64_t sampleButtons(alarm_id_t id, void* userData);
+
+// Start the sampling alarm (input core)
+void startButtonSampling() {
+    buttonSampling = true;
+    alarm_id_t id = alarm_pool_add_alarm_in_us(buttonAlarmPool, buttonTickUs, sampleButtons, nullptr, true);
+    if (id > 0) {
+        buttonAlarmId = id;
+    } else if (id < 0) {
+        buttonSampling = false;  // No free alarm; the next edge tries again
+    }
+}
+
+// Edge on any button pin
+void buttonEdgeISR() {
+    uint32_t start = cycleCount();
+    if (!buttonSampling) {
+        startButtonSampling();
+    }
+    profile[PROF_BUTTON_ISR].add(cyclesBetween(start, cycleCount()));
+}
+
+// Alarm callback: one bank read, one vertical-counter step for every pin.
+// A pin's counter counts down while it reads different from its debounced
+// state and reloads as soon as it reads the same; it wraps after
+// DEBOUNCE_SAMPLES differing samples in a row, which toggles the state.
+// Returns the next tick (after the previous deadline), or 0 once settled.
+int64_t sampleButtons(alarm_id_t, void*) {
+    uint32_t start = cycleCount();
+    uint32_t pressed = ~gpio_get_all() & buttonPinMask;
+    uint32_t changed = pressed ^ buttonState;
+    
+    buttonCount0 = ~(buttonCount0 & changed);
+    buttonCount1 = buttonCount0 ^ (buttonCount1 & changed);
+    uint32_t toggled = changed & buttonCount0 & buttonCount1;
+    buttonState ^= toggled;
+    
+    // Everything that settled in this sample goes out as one snapshot
+    if (toggled != 0) {
+        InputEvent event = {(uint32_t)micros(), (int32_t)buttonState, EVT_BUTTONS, 0};
+        if (!buttonEvents.push(event)) {
+            buttonState ^= toggled;  // Ring full: debounce the changes again
+        }
+    }
+    
+    int64_t next = buttonTickUs;
+    if ((pressed ^ buttonState) == 0) {
+        buttonSampling = false;
+        next = 0;
+    }
+    profile[PROF_BUTTON_SAMPLE].add(cyclesBetween(start, cycleCount()));
+    return next;
+}
+
+// Pick up a new button configuration (input core). Every button restarts
+// from released, as configureButton() always did, and one sampling run
+// starts so a button held during configuration is still reported.
+void applyButtonConfig() {
+    uint32_t seq = __atomic_load_n(&buttonConfigSeq, __ATOMIC_ACQUIRE);
+    if (seq == appliedButtonConfigSeq || (seq & 1)) return;
+    
+    uint8_t pins[MAX_BUTTONS];
+    memcpy(pins, buttonConfigPins, sizeof(pins));
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&buttonConfigSeq, __ATOMIC_RELAXED) != seq) return;  // Torn, retry next pass
+    appliedButtonConfigSeq = seq;
+    
+    // Stop the debouncer before touching its state: with the edge
+    // interrupts detached and the alarm cancelled, nothing else reads it
+    for (uint8_t pin = 0; pin < 32; pin++) {
+        if (buttonPinMask & (1u << pin)) {
+            detachInterrupt(digitalPinToInterrupt(pin));
+        }
+    }
+    if (buttonSampling) {
+        alarm_pool_cancel_alarm(buttonAlarmPool, buttonAlarmId);
+        buttonSampling = false;
+    }
+    
+    uint32_t mask = 0;
+    for (uint8_t i = 0; i < MAX_BUTTONS; i++) {
+        if (pins[i] == 0) continue;
+        mask |= 1u << pins[i];
+        
+        // Configure pin with internal pull-up (button connects to GND)
+        pinMode(pins[i], INPUT_PULLUP);
+        attachInterrupt(digitalPinToInterrupt(pins[i]), buttonEdgeISR, CHANGE);
+    }
+    
+    buttonPinMask = mask;
+    buttonState = 0;
+    buttonCount0 = ~0u;
+    buttonCount1 = ~0u;
+    if (mask != 0) {
+        startButtonSampling();
+    }
+}
+
+// Busy time per core: time spent in loop passes that did work, next to
+// the total pass count and the longest pass
+void sendCoreStats() {
+    MessageWriter<240> json;
+    json.str("{\"type\":\"cores\",\"uptimeUs\":").u32(micros());
+    for (int core = 0; core < 2; core++) {
+        const CoreStats& stats = coreStats[core];
+        json.str(core == 0 ? ",\"core0\":{\"passes\":" : ",\"core1\":{\"passes\":").u32(stats.passes)
+            .str(",\"busyPasses\":").u32(stats.busyPasses)
+            .str(",\"busyUs\":").u32(stats.busyUs)
+            .str(",\"maxPassUs\":").u32(stats.maxPassUs).chr('}');
+    }
+    json.chr('}');
+    sendText(json.data(), json.size());
+}
+
+// Event ring sizing data: current depth, deepest fill and dropped pushes
+void sendRingStats() {
+    MessageWriter<200> json;
+    json.str("{\"type\":\"rings\",\"clicks\":{\"capacity\":").u32(clickEvents.capacity())
+        .str(",\"depth\":").u32(clickEvents.size())
+        .str(",\"highWater\":").u32(clickEvents.highWater())
+        .str(",\"overflows\":").u32(clickEvents.overflows())
+        .str("},\"buttons\":{\"capacity\":").u32(buttonEvents.capacity())
+        .str(",\"depth\":").u32(buttonEvents.size())
+        .str(",\"highWater\":").u32(buttonEvents.highWater())
+        .str(",\"overflows\":").u32(buttonEvents.overflows()).str("}}");
+    sendText(json.data(), json.size());
+}
+
+// Account one loop pass on a core
+void recordPass(CoreStats& stats, uint32_t passStart, bool worked) {
+    uint32_t elapsed = micros() - passStart;
+    stats.passes = stats.passes + 1;
+    if (worked) {
+        stats.busyPasses = stats.busyPasses + 1;
+        stats.busyUs = stats.busyUs + elapsed;
+    }
+    if (elapsed > stats.maxPassUs) {
+        stats.maxPassUs = elapsed;
+    }
+}
+
+// Charge the cycles since mark to a profile slot; returns the new mark
+uint32_t profilePhase(ProfileSlot slot, uint32_t mark) {
+    uint32_t now = cycleCount();
+    profile[slot].add(cyclesBetween(mark, now));
+    return now;
+}
+
+// False for the slots of the decoder that is not running, and for hid
+// in builds without it
+bool profileSlotActive(size_t slot) {
+    if (slot == PROF_ENCODER_ISR || slot == PROF_ISR_INTERVAL) return !pioDecoderActive();
+    if (slot == PROF_POLL_ENCODER) return pioDecoderActive();
+    if (slot == PROF_HID) return ENCODER_HID;
+    return true;
+}
+
+// One histogram message. Buckets are powers of two (see cycle_profile.h);
+// "from" is the index of the first one listed, and empty buckets at either
+// end are left out. Inactive slots stay empty and are sent with
+// "active":false.
+bool sendProfileHistogram(size_t slot) {
+    const CycleHistogram& h = profile[slot];
+    size_t first = CycleHistogram::BUCKETS;
+    size_t last = 0;
+    for (size_t i = 0; i < CycleHistogram::BUCKETS; i++) {
+        if (h.bucket(i) == 0) continue;
+        if (i < first) first = i;
+        last = i + 1;
+    }
+    if (last == 0) first = 0;
+    MessageWriter<MAX_RECORD_SIZE> json;
+    json.str("{\"type\":\"stats_histogram\",\"name\":\"").str(PROFILE_NAMES[slot])
+        .str(slot == PROF_ISR_INTERVAL ? "\",\"unit\":\"us\"" : "\",\"unit\":\"cycles\"")
+        .str(",\"n\":").u32(h.count())
+        .str(",\"sum\":").u64(h.total())
+        .str(",\"max\":").u32(h.max())
+        .str(profileSlotActive(slot) ? ",\"active\":true" : ",\"active\":false")
+        .str(",\"from\":").u32((uint32_t)first)
+        .str(",\"counts\":[");
+    for (size_t i = first; i < last; i++) {
+        if (i > first) json.chr(',');
+        json.u32(h.bucket(i));
+    }
+    json.str("]}");
+    return sendTextIfRoom(json.data(), json.size());
+}
+
+// The summary closes the reply
+bool sendProfileSummary() {
+    LineWriter json;
+    json.str("{\"type\":\"stats\",\"cpuHz\":").u32(cycleCounterHz())
+        .str(",\"windowUs\":").u32(micros() - profileSinceMicros)
+        .str(",\"histograms\":").u32(PROF_COUNT).chr('}');
+    return sendTextIfRoom(json.data(), json.size());
+}
+
+// Start a new profile window. Core 0's histograms clear here, core 1's
+// on its next pass.
+void resetProfileStats() {
+    for (size_t slot = PROF_LOOP; slot < PROF_COUNT; slot++) {
+        profile[slot].clear();
+    }
+    profileResetRequested = true;
+    profileSinceMicros = micros();
+}
+
+// Send the next message of a stats reply. One per pass and only when the
+// port has room, like the bench flood, so a slow host never holds this
+// core up; the window restarts once the summary is out. Returns true if
+// anything was sent.
+bool serviceProfileStats() {
+    if (profileReplyNext < 0) return false;
+    if (!Serial) {
+        profileReplyNext = -1;      // Port closed mid-reply; ask again
+        return false;
+    }
+    if (profileReplyNext < PROF_COUNT) {
+        if (!sendProfileHistogram((size_t)profileReplyNext)) return false;
+        profileReplyNext++;
+        return true;
+    }
+    if (!sendProfileSummary()) return false;
+    resetProfileStats();
+    profileReplyNext = -1;
+    return true;
 }
 
 // Initialize buttons array
@@ -220,129 +1156,640 @@ void initButtons() {
     clearButtons();
 }
 
-void handleCommand(const String& line) {
-    // Simple text commands (for easy serial monitor testing)
-    String trimmed = line;
-    trimmed.trim();
-    
-    if (trimmed.equalsIgnoreCase("test")) {
-        // Quick test mode - configure GP2-GP7 as buttons
-        clearButtons();
-        uint8_t testPins[] = {2, 3, 4, 5, 6, 7};
-        for (uint8_t i = 0; i < 6; i++) {
-            configureButton(i, testPins[i]);
+// Valid button GPIO range
+bool isButtonPin(long pin) {
+    return pin >= 2 && pin <= 29;
+}
+
+// ==================== COMMAND HANDLERS ====================
+
+// Text command "test" - configure GP2-GP7 as buttons
+void textTest() {
+    clearButtons();
+    uint8_t testPins[] = {2, 3, 4, 5, 6, 7};
+    for (uint8_t i = 0; i < 6; i++) {
+        configureButton(i, testPins[i]);
+    }
+    numConfiguredButtons = 6;
+    sendText("{\"type\":\"test_mode\",\"pins\":[2,3,4,5,6,7],\"msg\":\"Ground GP2-GP7 to test buttons\"}");
+}
+
+// Text command "status"
+void textStatus() {
+    MessageWriter<96> json;
+    json.str("{\"type\":\"status\",\"buttons\":").u32(numConfiguredButtons)
+        .str(",\"position\":").u32(encoderDialPosition)
+        .str(",\"count\":").i64(encoderCount)
+        .str(",\"rev\":").i64(encoderRevolutions).chr('}');
+    sendText(json.data(), json.size());
+}
+
+void textHelp();
+
+// Reset the count: {"type":"reset","count":0} ("position" is accepted too)
+void commandReset(const JsonCommand& cmd) {
+    // Apply clicks already handed over so they don't land after the reset
+    drainInputEvents();
+    
+    int64_t count = 0;
+    if (!cmd.getInt64("count", count)) cmd.getInt64("position", count);
+    setEncoderCount(count);
+    // The partial click belongs to the decoder; ask it to drop it
+    pulseResetRequested = true;
+    accumulatedClicks = 0;
+    
+    sendEncoderData(0, encoderDialPosition, encoderCount, currentVelocity(), micros());
+}
+
+// Liveness check: {"type":"ping"}
+void commandPing(const JsonCommand&) {
+    sendPong(encoderDialPosition, encoderCount);
+}
+
+// Button configuration: {"type":"buttons","pins":[2,3,4,5]}
+void commandButtons(const JsonCommand& cmd) {
+    clearButtons();
+    
+    JsonArrayReader pins(cmd.getArray("pins"));
+    uint8_t buttonIndex = 0;
+    long pin;
+    while (buttonIndex < MAX_BUTTONS && pins.nextNumber(pin)) {
+        if (isButtonPin(pin)) {
+            configureButton(buttonIndex, pin);
+            buttonIndex++;
         }
-        numConfiguredButtons = 6;
-        Serial.println("{\"type\":\"test_mode\",\"pins\":[2,3,4,5,6,7],\"msg\":\"Ground GP2-GP7 to test buttons\"}");
-        return;
     }
-    if (trimmed.equalsIgnoreCase("status")) {
-        Serial.print("{\"type\":\"status\",\"buttons\":");
-        Serial.print(numConfiguredButtons);
-        Serial.print(",\"position\":");
-        Serial.print(encoderPosition);
-        Serial.println("}");
-        return;
+    numConfiguredButtons = buttonIndex;
+    
+    // Confirm configuration
+    LineWriter json;
+    json.str("{\"type\":\"buttons_configured\",\"count\":").u32(numConfiguredButtons).chr('}');
+    sendText(json.data(), json.size());
+}
+
+// Clear buttons: {"type":"clear_buttons"}
+void commandClearButtons(const JsonCommand&) {
+    clearButtons();
+    sendText("{\"type\":\"buttons_cleared\"}");
+}
+
+// Test mode: {"type":"test"} - configures GP2-GP7 as buttons for testing
+void commandTest(const JsonCommand&) {
+    clearButtons();
+    uint8_t testPins[] = {2, 3, 4, 5, 6, 7};
+    for (uint8_t i = 0; i < 6; i++) {
+        configureButton(i, testPins[i]);
     }
-    if (trimmed.equalsIgnoreCase("help")) {
-        Serial.println("{\"type\":\"help\",\"commands\":[\"test\",\"status\",\"help\"]}");
-        return;
+    numConfiguredButtons = 6;
+    sendText("{\"type\":\"test_mode\",\"pins\":[2,3,4,5,6,7]}");
+}
+
+// Capability handshake: {"type":"hello"} - repeats the ready message
+void commandHello(const JsonCommand&) {
+    sendReady();
+}
+
+// Output protocol: {"type":"protocol","mode":"binary"} or {"type":"protocol","mode":"json"}
+void commandProtocol(const JsonCommand& cmd) {
+    bool binary = cmd.stringIs("mode", "binary");
+    // Acknowledge in the current mode, so the host knows exactly where
+    // the stream switches format
+    sendText(binary ? "{\"type\":\"protocol\",\"mode\":\"binary\"}"
+                    : "{\"type\":\"protocol\",\"mode\":\"json\"}");
+    binaryMode = binary;
+}
+
+// Encoder report interval bounds: {"type":"report","minMs":2,"maxMs":50}
+void commandReport(const JsonCommand& cmd) {
+    long value;
+    if (cmd.getLong("minMs", value) && value >= 0 && value <= (long)REPORT_LIMIT_MS) {
+        reportMinMs = value;
+    }
+    if (cmd.getLong("maxMs", value) && value >= 0 && value <= (long)REPORT_LIMIT_MS) {
+        reportMaxMs = value;
     }
+    if (reportMaxMs < reportMinMs) reportMaxMs = reportMinMs;
+    reportIntervalMs = reportMinMs;
     
-    // Simple JSON command parsing
-    if (line.indexOf("\"type\":\"reset\"") >= 0) {
-        // Reset position counter
-        noInterrupts();
-        int posIdx = line.indexOf("\"position\":");
-        if (posIdx >= 0) {
-            int startIdx = posIdx + 11;
-            int endIdx = line.indexOf('}', startIdx);
-            if (endIdx < 0) endIdx = line.length();
-            String posStr = line.substring(startIdx, endIdx);
-            int commaIdx = posStr.indexOf(',');
-            if (commaIdx >= 0) posStr = posStr.substring(0, commaIdx);
-            posStr.trim();
-            encoderPosition = posStr.toInt();
-        } else {
-            encoderPosition = 0;
+    LineWriter json;
+    json.str("{\"type\":\"report\",\"minMs\":").u32(reportMinMs)
+        .str(",\"maxMs\":").u32(reportMaxMs).chr('}');
+    sendText(json.data(), json.size());
+}
+
+// Per-core loop accounting: {"type":"cores"}
+void commandCores(const JsonCommand&) {
+    sendCoreStats();
+}
+
+// Button report mode: {"type":"buttons_mode","mode":"snapshot"} or "edges"
+void commandButtonsMode(const JsonCommand& cmd) {
+    buttonSnapshotMode = cmd.stringIs("mode", "snapshot");
+    sendText(buttonSnapshotMode ? "{\"type\":\"buttons_mode\",\"mode\":\"snapshot\"}"
+                                : "{\"type\":\"buttons_mode\",\"mode\":\"edges\"}");
+}
+
+// Chord definitions: {"type":"chords","chords":[[2,5],[2,6,7]]} ([] clears)
+void commandChords(const JsonCommand& cmd) {
+    numChords = 0;
+    activeChords = 0;
+    chordConsumedPins = 0;
+    
+    JsonArrayReader chords(cmd.getArray("chords"));
+    JsonSpan chord;
+    while (numChords < MAX_CHORDS && chords.nextArray(chord)) {
+        JsonArrayReader pins(chord);
+        uint32_t mask = 0;
+        uint8_t count = 0;
+        long pin;
+        while (pins.nextNumber(pin)) {
+            if (isButtonPin(pin) && !(mask & (1u << pin))) {
+                mask |= 1u << pin;
+                count++;
+            }
         }
-        accumulatedPulses = 0;
-        accumulatedClicks = 0;
-        interrupts();
         
-        sendEncoderData(0, encoderPosition);
+        // A chord needs at least two buttons
+        if (count >= 2) {
+            chordMasks[numChords++] = mask;
+        }
     }
-    else if (line.indexOf("\"type\":\"ping\"") >= 0) {
-        sendPong(encoderPosition);
+    
+    LineWriter json;
+    json.str("{\"type\":\"chords_configured\",\"count\":").u32(numChords).chr('}');
+    sendText(json.data(), json.size());
+}
+
+// Button debounce time: {"type":"debounce","ms":20}
+void commandDebounce(const JsonCommand& cmd) {
+    long ms;
+    if (cmd.getLong("ms", ms) && ms >= 1 && ms <= (long)DEBOUNCE_MAX_MS) {
+        buttonTickUs = (uint32_t)ms * 1000 / DEBOUNCE_SAMPLES;
     }
-    // Button configuration: {"type":"buttons","pins":[2,3,4,5]}
-    else if (line.indexOf("\"type\":\"buttons\"") >= 0) {
-        clearButtons();
-        
-        int pinsIdx = line.indexOf("\"pins\":[");
-        if (pinsIdx >= 0) {
-            int startIdx = pinsIdx + 8;
-            int endIdx = line.indexOf(']', startIdx);
-            if (endIdx > startIdx) {
-                String pinsStr = line.substring(startIdx, endIdx);
-                uint8_t buttonIndex = 0;
-                
-                // Parse comma-separated pin numbers
-                int pos = 0;
-                while (pos < pinsStr.length() && buttonIndex < MAX_BUTTONS) {
-                    int commaIdx = pinsStr.indexOf(',', pos);
-                    if (commaIdx < 0) commaIdx = pinsStr.length();
-                    
-                    String pinStr = pinsStr.substring(pos, commaIdx);
-                    pinStr.trim();
-                    int pin = pinStr.toInt();
-                    
-                    if (pin >= 2 && pin <= 29) {  // Valid GPIO range
-                        configureButton(buttonIndex, pin);
-                        buttonIndex++;
-                    }
-                    pos = commaIdx + 1;
-                }
-                numConfiguredButtons = buttonIndex;
-            }
+    
+    LineWriter json;
+    json.str("{\"type\":\"debounce\",\"ms\":").u32(buttonTickUs * DEBOUNCE_SAMPLES / 1000).chr('}');
+    sendText(json.data(), json.size());
+}
+
+// Encoder resolution: {"type":"resolution","ppr":100,"decode":4}
+// The count carries on in the new unit; the dial position is re-derived.
+void commandResolution(const JsonCommand& cmd) {
+    long ppr, decode;
+    if (cmd.getLong("ppr", ppr) && ppr >= 1 && ppr <= (long)MAX_PPR) {
+        encoderPpr = (uint16_t)ppr;
+    }
+    if (cmd.getLong("decode", decode) && (decode == 1 || decode == 2 || decode == 4) &&
+        decode != encoderDecode) {
+        // Counts already captured belong to the old unit
+        drainInputEvents();
+        encoderDecode = (uint8_t)decode;
+        edgesPerCount = (uint8_t)(4 / decode);
+        pulseResetRequested = true;
+    }
+    setEncoderCount(encoderCount);
+    
+    LineWriter json;
+    json.str("{\"type\":\"resolution\",\"ppr\":").u32(encoderPpr)
+        .str(",\"decode\":").u32(encoderDecode)
+        .str(",\"countsPerRev\":").u32(countsPerRev()).chr('}');
+    sendText(json.data(), json.size());
+}
+
+// Current state for a host that lost events it can no longer get back.
+// The count covers every event up to seq; clicks not yet in an event
+// arrive later as usual.
+void sendResync() {
+    eventHistory.skipPending();
+    LineWriter json;
+    json.str("{\"type\":\"resync\",\"seq\":").u32(eventHistory.last())
+        .str(",\"count\":").i64(encoderCount - accumulatedClicks)
+        .str(",\"buttons\":").u32(reportedButtonMask).chr('}');
+    sendText(json.data(), json.size());
+}
+
+// Replay events from a sequence number: {"type":"resend","from":17}
+void commandResend(const JsonCommand& cmd) {
+    resendRequests++;
+    int64_t from;
+    if (cmd.getInt64("from", from) && from >= 1 && from <= (int64_t)UINT32_MAX &&
+        eventHistory.rewind((uint32_t)from)) {
+        deliverEvents();        // The replayed events are the reply
+        return;
+    }
+    resyncReplies++;
+    sendResync();
+}
+
+// Delivery counters: {"type":"events"}
+void commandEvents(const JsonCommand&) {
+    LineWriter json;
+    json.str("{\"type\":\"events\",\"seq\":").u32(eventHistory.last())
+        .str(",\"oldest\":").u32(eventHistory.oldest())
+        .str(",\"pending\":").u32(eventHistory.pending())
+        .str(",\"dropped\":").u32(eventHistory.dropped())
+        .str(",\"resends\":").u32(resendRequests)
+        .str(",\"replayed\":").u32(eventHistory.replayed())
+        .str(",\"resyncs\":").u32(resyncReplies)
+        .str(",\"stalls\":").u32(eventStalls).chr('}');
+    sendText(json.data(), json.size());
+}
+
+// Event ring fill and overflow counters: {"type":"rings"}
+void commandRings(const JsonCommand&) {
+    sendRingStats();
+}
+
+// ISR and loop cycle histograms since the last call: {"type":"stats"}.
+// The reply goes out over the next passes (serviceProfileStats); asking
+// again while it does starts it over.
+void commandStats(const JsonCommand&) {
+    profileReplyNext = 0;
+}
+
+// Background colour for a GRBL state name ("Idle", "Hold:0", ...)
+uint32_t ledColorForState(JsonSpan state) {
+    size_t len = 0;
+    while (len < state.len && state.ptr[len] != ':') len++;
+    for (const LedStateColor& entry : LED_STATE_COLORS) {
+        if (strlen(entry.state) == len && strncasecmp(state.ptr, entry.state, len) == 0) {
+            return entry.color;
         }
-        
-        // Confirm configuration
-        Serial.print("{\"type\":\"buttons_configured\",\"count\":");
-        Serial.print(numConfiguredButtons);
-        Serial.println("}");
-    }
-    // Clear buttons: {"type":"clear_buttons"}
-    else if (line.indexOf("\"type\":\"clear_buttons\"") >= 0) {
-        clearButtons();
-        Serial.println("{\"type\":\"buttons_cleared\"}");
-    }
-    // Test mode: {"type":"test"} - configures GP2-GP7 as buttons for testing
-    else if (line.indexOf("\"type\":\"test\"") >= 0) {
-        clearButtons();
-        uint8_t testPins[] = {2, 3, 4, 5, 6, 7};
-        for (uint8_t i = 0; i < 6; i++) {
-            configureButton(i, testPins[i]);
+    }
+    return COLOR_OFF;
+}
+
+// Status LED: {"type":"led","on":true,"state":"Run"} or "color":[255,160,0]
+// "on":false keeps the LED dark; "state" picks the machine-state background
+void commandLed(const JsonCommand& cmd) {
+    bool on;
+    if (cmd.getBool("on", on)) {
+        ledEffects.setEnabled(on);
+    }
+    const JsonField* state = cmd.field("state");
+    if (state && state->kind == JSON_STRING) {
+        ledEffects.setStateColor(ledColorForState(state->value));
+    }
+    JsonArrayReader rgb(cmd.getArray("color"));
+    long r, g, b;
+    if (rgb.nextNumber(r) && rgb.nextNumber(g) && rgb.nextNumber(b)) {
+        ledEffects.setStateColor(((uint32_t)constrain(r, 0, 255) << 16) |
+                                 ((uint32_t)constrain(g, 0, 255) << 8) |
+                                 (uint32_t)constrain(b, 0, 255));
+    }
+    
+    uint32_t color = ledEffects.getStateColor();
+    LineWriter json;
+    json.str("{\"type\":\"led\",\"on\":").str(ledEffects.isEnabled() ? "true" : "false")
+        .str(",\"color\":[").u32((color >> 16) & 0xFF)
+        .chr(',').u32((color >> 8) & 0xFF)
+        .chr(',').u32(color & 0xFF).str("]}");
+    sendText(json.data(), json.size());
+}
+
+#if ENCODER_HID
+// Event transport: {"type":"transport","events":"hid"} or "serial"
+void commandTransport(const JsonCommand& cmd) {
+    hidEvents = cmd.stringIs("events", "hid");
+    hidPendingClicks = 0;
+    hidButtonsChanged = hidEvents;
+    hidReportDue = hidEvents;        // First report carries the current state
+    sendText(hidEvents ? "{\"type\":\"transport\",\"events\":\"hid\"}"
+                       : "{\"type\":\"transport\",\"events\":\"serial\"}");
+}
+#endif
+
+// ==================== LINK BENCHMARK ====================
+// Measures the serial link itself: echo for round trips, flood for the
+// rate and message size it sustains. Bench frames are their own message
+// type (JSON "bench_echo"/"bench_flood", binary REC_BENCH), never events,
+// so a connected app ignores them. tools/link_bench.cpp drives these.
+
+const uint8_t BENCH_ECHO = 1;
+const uint8_t BENCH_FLOOD = 2;
+const uint32_t BENCH_MAX_RATE = 20000;     // Frames per second
+const uint32_t BENCH_BURST = 16;           // Frames per loop pass when behind
+
+struct BenchState {
+    bool running;
+    uint32_t rate;
+    uint32_t size;              // Bytes per frame on the wire, 0 = unpadded
+    uint32_t count;             // Frames to emit
+    uint32_t next;              // Next frame number
+    uint32_t startMicros;
+    uint32_t endMicros;
+    uint32_t sent;
+    uint32_t dropped;           // No room in the transmit buffer when due
+    uint32_t late;              // Skipped because the loop fell behind
+    uint32_t bytes;
+    uint32_t maxLateUs;         // Longest due -> written delay
+};
+BenchState bench = {};
+
+// Write one bench frame if it fits; size is the wire size to pad up to
+bool writeBenchFrame(uint8_t kind, uint32_t seq, uint32_t rx, uint32_t size, FlushPolicy policy,
+                     size_t* written) {
+    uint32_t tx = micros();
+    if (binaryMode) {
+        uint8_t record[MAX_RECORD_SIZE + 2];
+        // Zero padding adds no COBS overhead: type..padding + CRC + code + delimiter
+        size_t len = size > REC_BENCH_SIZE + 4 ? size - 4 : REC_BENCH_SIZE;
+        if (len > MAX_RECORD_SIZE) len = MAX_RECORD_SIZE;
+        memset(record, 0, len);
+        record[0] = REC_BENCH;
+        record[1] = kind;
+        putLe32(record + 2, seq);
+        putLe32(record + 6, rx);
+        putLe32(record + 10, tx);
+        uint8_t frame[framedSize(MAX_RECORD_SIZE)];
+        size_t n = frameRecord(record, len, frame);
+        if (!canWrite(n)) return false;
+        writeMessage(frame, n, policy);
+        *written = n;
+        return true;
+    }
+    MessageWriter<MAX_RECORD_SIZE + 2> line;
+    line.str(kind == BENCH_ECHO ? "{\"type\":\"bench_echo\",\"seq\":" : "{\"type\":\"bench_flood\",\"seq\":").u32(seq)
+        .str(kind == BENCH_ECHO ? ",\"rx\":" : ",\"due\":").u32(rx)
+        .str(",\"tx\":").u32(tx);
+    // ,"pad":"..."} and \r\n take 12 bytes around the padding
+    if (line.size() + 12 < size) {
+        line.str(",\"pad\":\"");
+        for (size_t pad = size - line.size() - 4; pad > 0; pad--) line.chr('x');
+        line.chr('"');
+    }
+    line.chr('}').endLine();
+    if (!canWrite(line.size())) return false;
+    writeLine(line, policy);
+    *written = line.size();
+    return true;
+}
+
+void sendBenchSummary() {
+    uint32_t elapsed = (bench.running ? micros() : bench.endMicros) - bench.startMicros;
+    uint32_t ratePerSec = elapsed > 0 ? (uint32_t)((uint64_t)bench.sent * 1000000 / elapsed) : 0;
+    uint32_t bytesPerSec = elapsed > 0 ? (uint32_t)((uint64_t)bench.bytes * 1000000 / elapsed) : 0;
+    MessageWriter<MAX_RECORD_SIZE> json;
+    json.str("{\"type\":\"bench_summary\",\"running\":").str(bench.running ? "true" : "false")
+        .str(",\"rate\":").u32(bench.rate)
+        .str(",\"size\":").u32(bench.size)
+        .str(",\"sent\":").u32(bench.sent)
+        .str(",\"dropped\":").u32(bench.dropped)
+        .str(",\"late\":").u32(bench.late)
+        .str(",\"bytes\":").u32(bench.bytes)
+        .str(",\"elapsedUs\":").u32(elapsed)
+        .str(",\"achievedRate\":").u32(ratePerSec)
+        .str(",\"bytesPerSec\":").u32(bytesPerSec)
+        .str(",\"maxLateUs\":").u32(bench.maxLateUs).chr('}');
+    sendText(json.data(), json.size());
+}
+
+// Emit the flood frames that are due. Returns true if any work was done.
+bool serviceBench() {
+    if (!bench.running) return false;
+    uint32_t now = micros();
+    uint32_t elapsed = now - bench.startMicros;
+    // Frames due so far, capped at the requested count
+    uint64_t due = (uint64_t)elapsed * bench.rate / 1000000 + 1;
+    if (due > bench.count) due = bench.count;
+    if (bench.next >= due) return false;
+    
+    if (due - bench.next > BENCH_BURST) {
+        uint32_t skip = (uint32_t)(due - bench.next) - BENCH_BURST;
+        bench.late += skip;
+        bench.next += skip;
+    }
+    while (bench.next < due) {
+        uint32_t seq = bench.next++;
+        uint32_t dueMicros = bench.startMicros + (uint32_t)((uint64_t)seq * 1000000 / bench.rate);
+        size_t written = 0;
+        if (writeBenchFrame(BENCH_FLOOD, seq, dueMicros, bench.size, FLUSH_NOW, &written)) {
+            bench.sent++;
+            bench.bytes += written;
+            uint32_t lateUs = micros() - dueMicros;
+            if (lateUs > bench.maxLateUs) bench.maxLateUs = lateUs;
+        } else {
+            bench.dropped++;
+        }
+    }
+    
+    if (bench.next >= bench.count) {
+        bench.running = false;
+        bench.endMicros = micros();
+        sendBenchSummary();
+    }
+    return true;
+}
+
+// Link benchmark:
+//   {"type":"bench","mode":"echo","seq":7,"size":64}      one frame back at once
+//   {"type":"bench","mode":"flood","rate":1000,"size":110,"count":5000}
+//   {"type":"bench","mode":"summary"}                      counters of the last flood
+//   {"type":"bench","mode":"stop"}                         end a flood early
+void commandBench(const JsonCommand& cmd) {
+    uint32_t rx = micros();
+    long size = 0;
+    cmd.getLong("size", size);
+    size = constrain(size, 0L, (long)MAX_RECORD_SIZE);
+    
+    if (cmd.stringIs("mode", "echo")) {
+        int64_t seq = 0;
+        cmd.getInt64("seq", seq);
+        size_t written = 0;
+        // Nothing is queued for later: a full buffer loses the echo, which
+        // the host counts as lost
+        writeBenchFrame(BENCH_ECHO, (uint32_t)seq, rx, (uint32_t)size, FLUSH_NOW, &written);
+        return;
+    }
+    if (cmd.stringIs("mode", "flood")) {
+        long rate = 1000;
+        long count = 1000;
+        cmd.getLong("rate", rate);
+        cmd.getLong("count", count);
+        bench = {};
+        bench.rate = (uint32_t)constrain(rate, 1L, (long)BENCH_MAX_RATE);
+        bench.count = (uint32_t)(count > 0 ? count : 1);
+        bench.size = (uint32_t)size;
+        bench.startMicros = rx;
+        bench.running = true;
+        return;
+    }
+    if (cmd.stringIs("mode", "stop") && bench.running) {
+        bench.running = false;
+        bench.endMicros = micros();
+    }
+    sendBenchSummary();
+}
+
+// ==================== COMMAND TABLE ====================
+// The one place commands are declared. Dispatch, the help reply and the
+// command list in the ready message are all generated from these tables.
+
+struct TextCommandEntry {
+    const char* name;
+    void (*handler)();
+};
+
+struct JsonCommandEntry {
+    const char* name;           // "type" value
+    void (*handler)(const JsonCommand& cmd);
+};
+
+// Plain-text commands for serial monitor testing (case-insensitive)
+constexpr TextCommandEntry TEXT_COMMANDS[] = {
+    {"test",   textTest},
+    {"status", textStatus},
+    {"help",   textHelp},
+};
+
+constexpr JsonCommandEntry JSON_COMMANDS[] = {
+    {"reset",         commandReset},
+    {"ping",          commandPing},
+    {"buttons",       commandButtons},
+    {"clear_buttons", commandClearButtons},
+    {"test",          commandTest},
+    {"hello",         commandHello},
+    {"protocol",      commandProtocol},
+    {"report",        commandReport},
+    {"cores",         commandCores},
+    {"buttons_mode",  commandButtonsMode},
+    {"chords",        commandChords},
+    {"debounce",      commandDebounce},
+    {"rings",         commandRings},
+    {"led",           commandLed},
+    {"resend",        commandResend},
+    {"events",        commandEvents},
+    {"resolution",    commandResolution},
+    {"bench",         commandBench},
+    {"stats",         commandStats},
+#if ENCODER_HID
+    {"transport",     commandTransport},
+#endif
+};
+
+constexpr auto JSON_COMMAND_INDEX = buildPerfectHash<32>(JSON_COMMANDS);
+static_assert(JSON_COMMAND_INDEX.valid, "No perfect hash seed for JSON_COMMANDS; grow the index");
+
+// Append "name","name",... for a command table
+template <size_t W, typename Entry, size_t N>
+void appendCommandNames(MessageWriter<W>& json, const Entry (&entries)[N]) {
+    for (size_t i = 0; i < N; i++) {
+        json.str(i == 0 ? "\"" : ",\"").str(entries[i].name).chr('"');
+    }
+}
+
+// Text command "help" - lists both command sets
+void textHelp() {
+    MessageWriter<MAX_RECORD_SIZE> json;
+    json.str("{\"type\":\"help\",\"commands\":[");
+    appendCommandNames(json, TEXT_COMMANDS);
+    json.str("],\"json\":[");
+    appendCommandNames(json, JSON_COMMANDS);
+    json.str("]}");
+    sendText(json.data(), json.size());
+}
+
+// Capabilities; "ppr"/"decode" the current encoder resolution, "seq" the
+// last event sequence number, "binary" the binary protocol version the
+// host may opt into, "hid" the HID report size (0 = no HID interface),
+// "commands" the JSON command types this build accepts
+void sendReady() {
+    MessageWriter<MAX_RECORD_SIZE> json;
+    json.str("{\"type\":\"ready\",\"device\":\"").str(DEVICE_NAME)
+        .str("\",\"encoder\":\"").u32(encoderPpr)
+        .str("PPR\",\"ppr\":").u32(encoderPpr)
+        .str(",\"decode\":").u32(encoderDecode)
+        .str(",\"seq\":").u32(eventHistory.last())
+        .str(",\"maxButtons\":").u32(MAX_BUTTONS)
+        .str(",\"pins\":{\"a\":0,\"b\":1},\"binary\":").u32(BINARY_PROTOCOL_VERSION)
+        .str(",\"buttonSnapshots\":1,\"maxChords\":").u32(MAX_CHORDS)
+        .str(",\"hid\":").u32(ENCODER_HID ? (uint32_t)HID_REPORT_SIZE : 0u)
+        .str(",\"commands\":[");
+    appendCommandNames(json, JSON_COMMANDS);
+    json.str("]}");
+    sendText(json.data(), json.size());
+}
+
+// Compare a received text command, ignoring case and surrounding whitespace
+bool isTextCommand(const char* line, size_t len, const char* command) {
+    while (len > 0 && json_detail::isSpace(*line)) { line++; len--; }
+    while (len > 0 && json_detail::isSpace(line[len - 1])) len--;
+    return strlen(command) == len && strncasecmp(line, command, len) == 0;
+}
+
+void handleCommand(const char* line, size_t len) {
+    // Simple text commands (for easy serial monitor testing)
+    for (const TextCommandEntry& entry : TEXT_COMMANDS) {
+        if (isTextCommand(line, len, entry.name)) {
+            entry.handler();
+            return;
         }
-        numConfiguredButtons = 6;
-        Serial.println("{\"type\":\"test_mode\",\"pins\":[2,3,4,5,6,7]}");
+    }
+    
+    // JSON commands: tokenized once, then one hash lookup on "type"
+    JsonCommand cmd;
+    if (!cmd.parse(line, len)) return;
+    JsonSpan type = cmd.type();
+    if (type.ptr == nullptr) return;
+    
+    int index = JSON_COMMAND_INDEX.find(type.ptr, type.len);
+    if (index >= 0 && type.equals(JSON_COMMANDS[index].name)) {
+        JSON_COMMANDS[index].handler(cmd);
     }
 }
 
 void sendHeartbeat() {
-    Serial.print("{\"type\":\"heartbeat\",\"position\":");
-    Serial.print(encoderPosition);
-    Serial.print(",\"pinA\":");
-    Serial.print(digitalRead(PIN_A));
-    Serial.print(",\"pinB\":");
-    Serial.print(digitalRead(PIN_B));
-    Serial.println("}");
+    if (binaryMode) {
+        uint8_t record[REC_HEARTBEAT_SIZE + 2];
+        record[0] = REC_HEARTBEAT;
+        putLe32(record + 1, encoderDialPosition);
+        record[5] = (uint8_t)(digitalRead(PIN_A) | (digitalRead(PIN_B) << 1));
+        putLe64(record + 6, (uint64_t)encoderCount);
+        putLe32(record + 14, eventHistory.lastDelivered());
+        sendRecord(record, REC_HEARTBEAT_SIZE, FLUSH_END_OF_PASS);
+        return;
+    }
+    LineWriter line;
+    line.str("{\"type\":\"heartbeat\",\"seq\":").u32(eventHistory.lastDelivered())
+        .str(",\"position\":").u32(encoderDialPosition)
+        .str(",\"count\":").i64(encoderCount)
+        .str(",\"rev\":").i64(encoderRevolutions)
+        .str(",\"pinA\":").u32(digitalRead(PIN_A))
+        .str(",\"pinB\":").u32(digitalRead(PIN_B))
+        .chr('}').endLine();
+    writeLine(line, FLUSH_END_OF_PASS);
+}
+
+#if LED_TYPE_NEOPIXEL
+// Load the WS2812 transmitter into a free state machine
+void beginLed() {
+    PIO candidates[] = {pio0, pio1};
+    for (PIO pio : candidates) {
+        if (!pio_can_add_program(pio, &ws2812_program)) continue;
+        int sm = pio_claim_unused_sm(pio, false);
+        if (sm < 0) continue;
+        
+        uint offset = pio_add_program(pio, &ws2812_program);
+        ws2812_program_init(pio, sm, offset, LED_PIN, 800000);
+        ledPio = pio;
+        ledSm = sm;
+        return;
+    }
 }
+#endif
 
+// Write a colour to the LED now. Outside setup() only serviceLed() calls this.
 void setLed(uint32_t color) {
+    ledShownColor = color;
+    ledLastWriteUs = micros();
 #if LED_TYPE_NEOPIXEL
-    led.setPixelColor(0, color);
-    led.show();
+    if (ledPio == nullptr) return;
+    uint32_t r = ((color >> 16) & 0xFF) * (LED_BRIGHTNESS + 1) >> 8;
+    uint32_t g = ((color >> 8) & 0xFF) * (LED_BRIGHTNESS + 1) >> 8;
+    uint32_t b = (color & 0xFF) * (LED_BRIGHTNESS + 1) >> 8;
+    // The state machine shifts out the top 24 bits (GRB); never blocks,
+    // as one pixel is far below the FIFO depth
+    pio_sm_put(ledPio, ledSm, ((g << 16) | (r << 8) | b) << 8);
 #elif LED_TYPE_RGB
     // Tiny2040 RGB LED - active LOW (0 = on, 1 = off)
     uint8_t r = (color >> 16) & 0xFF;
@@ -359,15 +1806,24 @@ void setLed(uint32_t color) {
 }
 
 void flashLed(uint32_t color, unsigned long durationMs) {
+    ledEffects.flash(color, durationMs, millis());
+}
+
+// Render the current effect and write it if it changed. Writes are spaced
+// so each WS2812 frame latches before the next one starts.
+bool serviceLed(unsigned long now) {
+    uint32_t color = ledEffects.render(now);
+    if (color == ledShownColor || (uint32_t)(micros() - ledLastWriteUs) < LED_MIN_WRITE_US) {
+        return false;
+    }
     setLed(color);
-    ledOffTime = millis() + durationMs;
+    return true;
 }
 
 void setup() {
 #if LED_TYPE_NEOPIXEL
     // Initialize NeoPixel RGB LED
-    led.begin();
-    led.setBrightness(30);  // Dim (0-255) - these LEDs are bright!
+    beginLed();
 #elif LED_TYPE_RGB
     // Initialize Tiny2040 RGB LED (3 separate pins, active LOW)
     pinMode(LED_PIN_R, OUTPUT);
@@ -379,19 +1835,27 @@ void setup() {
 #endif
     setLed(COLOR_RED);
     
+    startCycleCounter();
+    
     // Initialize buttons
     initButtons();
     
-    // Initialize encoder pins with pull-ups
-    pinMode(PIN_A, INPUT_PULLUP);
-    pinMode(PIN_B, INPUT_PULLUP);
-    
-    // Read initial encoder state
-    lastEncoded = (digitalRead(PIN_A) << 1) | digitalRead(PIN_B);
+#if !DUAL_CORE
+    setup1();
+#endif
     
-    // Attach interrupts to both encoder pins
-    attachInterrupt(digitalPinToInterrupt(PIN_A), encoderISR, CHANGE);
-    attachInterrupt(digitalPinToInterrupt(PIN_B), encoderISR, CHANGE);
+#if ENCODER_HID
+    // Add the HID interface; re-enumerate if the host has already
+    // configured the device without it
+    usbHid.setPollInterval(HID_POLL_INTERVAL_MS);
+    usbHid.setReportDescriptor(HID_REPORT_DESCRIPTOR, sizeof(HID_REPORT_DESCRIPTOR));
+    usbHid.begin();
+    if (TinyUSBDevice.mounted()) {
+        TinyUSBDevice.detach();
+        delay(10);
+        TinyUSBDevice.attach();
+    }
+#endif
     
     // Initialize USB Serial
     Serial.begin(115200);
@@ -415,91 +1879,242 @@ void setup() {
     sendReady();
 }
 
-void loop() {
-    unsigned long now = millis();
+// ==================== INPUT CORE ====================
+
+void setup1() {
+    // Button confirmation alarms fire on the core that creates the pool
+    buttonAlarmPool = alarm_pool_create_with_unused_hardware_alarm(4);
+    
+    startCycleCounter();
     
-    // Turn off LED after flash duration
-    if (ledOffTime > 0 && now >= ledOffTime) {
-        setLed(COLOR_OFF);
-        ledOffTime = 0;
+    // Initialize encoder pins with pull-ups
+    pinMode(PIN_A, INPUT_PULLUP);
+    pinMode(PIN_B, INPUT_PULLUP);
+    
+    // Read initial encoder state
+    lastEncoded = (digitalRead(PIN_A) << 1) | digitalRead(PIN_B);
+    
+    // Prefer the PIO decoder; attach interrupts to both encoder pins otherwise.
+    // Attaching from this core routes the GPIO interrupt to this core.
+#if ENCODER_USE_PIO
+    bool pioEncoder = beginPioEncoder();
+#else
+    bool pioEncoder = false;
+#endif
+    if (!pioEncoder) {
+        attachInterrupt(digitalPinToInterrupt(PIN_A), encoderISR, CHANGE);
+        attachInterrupt(digitalPinToInterrupt(PIN_B), encoderISR, CHANGE);
     }
+}
+
+// Buttons need no polling here: edge interrupts and the confirmation
+// alarm publish them
+void loop1() {
+    uint32_t passStart = micros();
+    uint32_t passCycles = cycleCount();
     
-    // Send accumulated encoder data at regular intervals
-    if (accumulatedClicks != 0 && (now - lastSendTime) >= SEND_INTERVAL_MS) {
+    // The encoder and button handlers add to these on this core; mask
+    // them so none is caught halfway through an add() (a few hundred
+    // stores, about 2 us)
+    if (profileResetRequested) {
         noInterrupts();
-        int clicks = accumulatedClicks;
-        long pos = encoderPosition;
-        accumulatedClicks = 0;
+        for (size_t slot = 0; slot < PROF_LOOP; slot++) {
+            profile[slot].clear();
+        }
         interrupts();
-        
-        sendEncoderData(clicks, pos);
-        lastSendTime = now;
-        
-        // Flash green on encoder movement
-        flashLed(COLOR_GREEN, 50);
+        profileResetRequested = false;
     }
     
+    applyButtonConfig();
+    
+    // Pick up pulses counted by the PIO decoder since the last pass
+    bool worked = pollEncoder();
+    
+    profile[PROF_LOOP1].add(cyclesBetween(passCycles, cycleCount()));
+    recordPass(coreStats[1], passStart, worked);
+}
+
+// ==================== PROTOCOL CORE ====================
+
+// Bring the reported position up to a captured click count
+void applyClickCount(int32_t count, uint32_t captureMicros) {
+    int32_t clicks = (int32_t)((uint32_t)count - (uint32_t)totalClicks);
+    if (clicks == 0) return;
+    
+    totalClicks = count;
+    advanceEncoderCount(clicks);
+    if (accumulatedClicks == 0) accumulatedSince = captureMicros;
+    accumulatedClicks += clicks;
+    if (hidEvents) {
+        hidPendingClicks += clicks;
+        hidReportDue = true;
+    }
+    
+    // Filter on capture time, not the time this core got to it
+    velocityEstimator.update(totalClicks, captureMicros);
+}
+
+// Apply events captured by the input side. Returns true if any arrived.
+bool drainInputEvents() {
+    bool worked = false;
+    InputEvent event;
+    while (clickEvents.pop(event)) {
+        applyClickCount(event.value, event.micros);
+        worked = true;
+    }
+    
+    // Clicks whose event was dropped on overflow
+    EncoderSnapshot snapshot = encoderSnapshot.load();
+    if (snapshot.clicks != totalClicks && clickEvents.size() == 0 &&
+        (uint32_t)micros() - snapshot.micros >= CLICK_CATCHUP_US) {
+        applyClickCount(snapshot.clicks, snapshot.micros);
+        worked = true;
+    }
+    
+    while (buttonEvents.pop(event)) {
+        handleButtonSnapshot((uint32_t)event.value, event.micros);
+        worked = true;
+    }
+    return worked;
+}
+
+#if ENCODER_HID
+// Send one HID report when something changed and the previous report has
+// been collected (at most one per poll interval)
+bool serviceHid() {
+    if (!hidReportDue || !usbHid.ready()) return false;
+    
+    HidEncoderReport report;
+    report.sequence = hidSequence++;
+    report.flags = hidButtonsChanged ? HID_FLAG_BUTTONS_CHANGED : 0;
+    report.delta = constrain(hidPendingClicks, -32767, 32767);
+    report.count = (int32_t)encoderCount;
+    report.velocity = currentVelocity();
+    report.buttons = reportedButtonMask;
+    report.position = (uint16_t)encoderDialPosition;
+    
+    uint8_t packed[HID_REPORT_SIZE];
+    packHidReport(report, packed);
+    if (!usbHid.sendReport(0, packed, sizeof(packed))) return false;
+    
+    hidPendingClicks -= report.delta;
+    hidButtonsChanged = false;
+    hidReportDue = hidPendingClicks != 0;
+    return true;
+}
+#endif
+
+void loop() {
+#if !DUAL_CORE
+    loop1();
+#endif
+    
+    uint32_t passStart = micros();
+    uint32_t passCycles = cycleCount();
+    unsigned long now = millis();
+    bool worked = drainInputEvents();
+    uint32_t mark = profilePhase(PROF_INPUT, passCycles);
+    
+    // Back to JSON once the host closes the port, so a serial monitor
+    // opened afterwards gets readable output
+    if ((binaryMode || hidEvents) && !Serial) {
+        binaryMode = false;
+        hidEvents = false;
+    }
+    
+    // Events held back while the host could not take them
+    if (eventHistory.pending() > 0 && deliverEvents()) {
+        worked = true;
+    }
+    mark = profilePhase(PROF_DELIVER, mark);
+    
+    // Send accumulated encoder data, coalescing while the wheel keeps moving
+    if ((now - lastSendTime) >= reportIntervalMs) {
+        if (accumulatedClicks != 0) {
+            int clicks = accumulatedClicks;
+            accumulatedClicks = 0;
+            
+            if (!hidEvents) {
+                sendEncoderData(clicks, encoderDialPosition, encoderCount, currentVelocity(), accumulatedSince);
+            }
+            lastSendTime = now;
+            // Double (from at least 1 ms), never past the host's maximum
+            unsigned long doubled = reportIntervalMs > 0 ? reportIntervalMs * 2 : 1;
+            reportIntervalMs = doubled < reportMaxMs ? doubled : reportMaxMs;
+            worked = true;
+            
+            // Flash green on encoder movement
+            flashLed(COLOR_GREEN, 50);
+        } else {
+            reportIntervalMs = reportMinMs;
+        }
+    }
+    mark = profilePhase(PROF_REPORT, mark);
+    
     // Send heartbeat periodically so we know the device is alive
     if ((now - lastHeartbeatTime) >= HEARTBEAT_INTERVAL_MS) {
         sendHeartbeat();
         lastHeartbeatTime = now;
+        worked = true;
         
-        // Brief blue flash on heartbeat (only if not already flashing)
-        if (ledOffTime == 0) {
-            flashLed(COLOR_BLUE, 100);
-        }
+        // Soft blue pulse on heartbeat (shown under any flash)
+        ledEffects.pulse(COLOR_BLUE, HEARTBEAT_PULSE_MS, now);
     }
+    mark = profilePhase(PROF_HEARTBEAT, mark);
     
-    // Scan configured buttons with debouncing
-    for (uint8_t i = 0; i < MAX_BUTTONS; i++) {
-        if (!buttons[i].enabled) continue;
-        
-        // Read button (active LOW - pressed when connected to GND)
-        bool reading = !digitalRead(buttons[i].pin);
-        
-        // If reading changed, reset debounce timer
-        if (reading != buttons[i].currentReading) {
-            buttons[i].currentReading = reading;
-            buttons[i].lastDebounceTime = now;
-        }
-        
-        // If reading has been stable for debounce period
-        if ((now - buttons[i].lastDebounceTime) >= DEBOUNCE_MS) {
-            // If state has changed
-            if (reading != buttons[i].lastState) {
-                buttons[i].lastState = reading;
-                sendButtonEvent(buttons[i].pin, reading);
-                
-                // Flash LED on button press
-                if (reading) {
-                    flashLed(COLOR_GREEN, 50);
-                }
-            }
-        }
+    // Link benchmark frames, when a flood is running
+    if (serviceBench()) {
+        worked = true;
     }
+    mark = profilePhase(PROF_BENCH, mark);
+    
+    // The next message of a stats reply
+    if (serviceProfileStats()) {
+        worked = true;
+    }
+    mark = profilePhase(PROF_STATS, mark);
     
     // Process incoming serial commands
     while (Serial.available() > 0) {
         char c = Serial.read();
         lastCharTime = now;
+        worked = true;
         
-        if (c == '\n' || c == '\r') {
-            if (inputBuffer.length() > 0) {
-                handleCommand(inputBuffer);
-                inputBuffer = "";
-            }
-        } else {
-            inputBuffer += c;
-            // Prevent buffer overflow
-            if (inputBuffer.length() > 256) {
-                inputBuffer = "";
-            }
+        if (commandLine.append(c)) {
+            handleCommand(commandLine.c_str(), commandLine.size());
+            commandLine.clear();
         }
     }
     
     // Timeout-based command processing (for serial monitors that don't send newline)
-    if (inputBuffer.length() > 0 && (now - lastCharTime) >= COMMAND_TIMEOUT_MS) {
-        handleCommand(inputBuffer);
-        inputBuffer = "";
+    if (commandLine.pending() && (now - lastCharTime) >= COMMAND_TIMEOUT_MS) {
+        if (!commandLine.empty()) {
+            handleCommand(commandLine.c_str(), commandLine.size());
+        }
+        commandLine.clear();
+        worked = true;
+    }
+    mark = profilePhase(PROF_COMMANDS, mark);
+    
+#if ENCODER_HID
+    if (serviceHid()) {
+        worked = true;
+    }
+    mark = profilePhase(PROF_HID, mark);
+#endif
+    
+    // Replies and heartbeats written during this pass go out together
+    if (flushOutput()) {
+        worked = true;
     }
+    mark = profilePhase(PROF_FLUSH, mark);
+    
+    // LED last, after everything input-related in this pass has gone out
+    if (serviceLed(now)) {
+        worked = true;
+    }
+    profilePhase(PROF_LED, mark);
+    
+    profile[PROF_LOOP].add(cyclesBetween(passCycles, cycleCount()));
+    recordPass(coreStats[0], passStart, worked);
 }
@@ -0,0 +1,139 @@
+/**
+ * Fixed-buffer builder for outgoing JSON lines
+ *
+ * A message is assembled on the stack and handed to Serial in one write,
+ * so it leaves as one USB transfer instead of one per print() call, and the
+ * host never sees half a line. Integers are formatted two digits at a time
+ * from a lookup table rather than through printf.
+ *
+ * Appends past the capacity are dropped and flagged; callers size the
+ * buffer for their longest message.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+namespace message_detail {
+    static const char DIGIT_PAIRS[] =
+        "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+        "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+        "8081828384858687888990919293949596979899";
+
+    // Write the digits of v so they end just before `end`; returns the first digit
+    inline char* formatUnsigned(uint32_t v, char* end) {
+        while (v >= 100) {
+            uint32_t q = v / 100;
+            end -= 2;
+            memcpy(end, DIGIT_PAIRS + (v - q * 100) * 2, 2);
+            v = q;
+        }
+        if (v >= 10) {
+            end -= 2;
+            memcpy(end, DIGIT_PAIRS + v * 2, 2);
+        } else {
+            *--end = (char)('0' + v);
+        }
+        return end;
+    }
+}
+
+template <size_t N>
+class MessageWriter {
+public:
+    MessageWriter& str(const char* s) {
+        return raw(s, strlen(s));
+    }
+
+    MessageWriter& raw(const char* s, size_t n) {
+        if (n > N - length) {
+            overflow = true;
+            n = N - length;
+        }
+        memcpy(buffer + length, s, n);
+        length += n;
+        return *this;
+    }
+
+    MessageWriter& chr(char c) {
+        return raw(&c, 1);
+    }
+
+    MessageWriter& u32(uint32_t v) {
+        char digits[10];
+        char* end = digits + sizeof(digits);
+        char* start = message_detail::formatUnsigned(v, end);
+        return raw(start, end - start);
+    }
+
+    MessageWriter& i32(int32_t v) {
+        if (v < 0) {
+            chr('-');
+            return u32(0u - (uint32_t)v);
+        }
+        return u32((uint32_t)v);
+    }
+
+    // Values that fit 32 bits take the u32 path; larger ones are split into
+    // 9-digit groups so only the split itself needs 64-bit division
+    MessageWriter& u64(uint64_t v) {
+        if (v <= 0xFFFFFFFFu) return u32((uint32_t)v);
+        char digits[20];
+        char* end = digits + sizeof(digits);
+        char* start = end;
+        while (v > 0xFFFFFFFFu) {
+            uint32_t group = (uint32_t)(v % 1000000000u);
+            v /= 1000000000u;
+            char* groupEnd = start;
+            start = message_detail::formatUnsigned(group, groupEnd);
+            while (start > groupEnd - 9) *--start = '0';
+        }
+        start = message_detail::formatUnsigned((uint32_t)v, start);
+        return raw(start, end - start);
+    }
+
+    MessageWriter& i64(int64_t v) {
+        if (v < 0) {
+            chr('-');
+            return u64(0u - (uint64_t)v);
+        }
+        return u64((uint64_t)v);
+    }
+
+    // One decimal place, rounded half away from zero (as print(v, 1))
+    MessageWriter& fixed1(float v) {
+        if (v < 0) {
+            chr('-');
+            v = -v;
+        }
+        // Out of range (or NaN) saturates rather than printing garbage
+        if (!(v < 4000000000.0f)) v = 4000000000.0f;
+        // Round the fraction on its own: it is exact in a float, while
+        // v * 10 would round before the half-way test
+        uint32_t whole = (uint32_t)v;
+        uint32_t tenth = (uint32_t)((v - (float)whole) * 10.0f + 0.5f);
+        if (tenth == 10) {
+            whole++;
+            tenth = 0;
+        }
+        u32(whole);
+        chr('.');
+        return chr((char)('0' + tenth));
+    }
+
+    // Line ending used by Serial.println()
+    MessageWriter& endLine() {
+        return raw("\r\n", 2);
+    }
+
+    const char* data() const { return buffer; }
+    size_t size() const { return length; }
+    bool overflowed() const { return overflow; }
+
+private:
+    char buffer[N];
+    size_t length = 0;
+    bool overflow = false;
+};
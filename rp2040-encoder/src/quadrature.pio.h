@@ -0,0 +1,109 @@
+// -------------------------------------------------- //
+// This file is autogenerated by pioasm; do not edit! //
+// -------------------------------------------------- //
+
+#pragma once
+
+#if !PICO_NO_HARDWARE
+#include "hardware/pio.h"
+#endif
+
+// ------------------ //
+// quadrature_encoder //
+// ------------------ //
+
+#define quadrature_encoder_wrap_target 17
+#define quadrature_encoder_wrap 26
+#define quadrature_encoder_pio_version 0
+
+#define quadrature_encoder_offset_sample 19u
+
+static const uint16_t quadrature_encoder_program_instructions[] = {
+    0x0011, //  0: jmp    17
+    0x0010, //  1: jmp    16
+    0x0018, //  2: jmp    24
+    0x0011, //  3: jmp    17
+    0x0018, //  4: jmp    24
+    0x0011, //  5: jmp    17
+    0x0011, //  6: jmp    17
+    0x0010, //  7: jmp    16
+    0x0010, //  8: jmp    16
+    0x0011, //  9: jmp    17
+    0x0011, // 10: jmp    17
+    0x0018, // 11: jmp    24
+    0x0011, // 12: jmp    17
+    0x0018, // 13: jmp    24
+    0x0010, // 14: jmp    16
+    0x0011, // 15: jmp    17
+    0x0051, // 16: jmp    x--, 17
+            //     .wrap_target
+    0xa0c1, // 17: mov    isr, x
+    0x8000, // 18: push   noblock
+    0xa0c3, // 19: mov    isr, null
+    0x40e2, // 20: in     osr, 2
+    0x4002, // 21: in     pins, 2
+    0xa0e6, // 22: mov    osr, isr
+    0xa0a6, // 23: mov    pc, isr
+    0xa029, // 24: mov    x, ~x
+    0x005a, // 25: jmp    x--, 26
+    0xa029, // 26: mov    x, ~x
+            //     .wrap
+};
+
+#if !PICO_NO_HARDWARE
+static const struct pio_program quadrature_encoder_program = {
+    .instructions = quadrature_encoder_program_instructions,
+    .length = 27,
+    .origin = 0,
+#if PICO_PIO_VERSION > 0
+    .pio_version = quadrature_encoder_pio_version,
+#endif
+};
+
+static inline pio_sm_config quadrature_encoder_program_get_default_config(uint offset) {
+    pio_sm_config c = pio_get_default_sm_config();
+    sm_config_set_wrap(&c, offset + quadrature_encoder_wrap_target, offset + quadrature_encoder_wrap);
+    return c;
+}
+
+#include "hardware/clocks.h"
+#include "hardware/gpio.h"
+
+// Program must be loaded at offset 0 because of the jump table.
+static inline void quadrature_encoder_program_init(PIO pio, uint sm, uint pin_a) {
+    pio_sm_set_consecutive_pindirs(pio, sm, pin_a, 2, false);
+    pio_gpio_init(pio, pin_a);
+    pio_gpio_init(pio, pin_a + 1);
+    gpio_pull_up(pin_a);
+    gpio_pull_up(pin_a + 1);
+
+    pio_sm_config c = quadrature_encoder_program_get_default_config(0);
+    sm_config_set_in_pins(&c, pin_a);
+    sm_config_set_in_shift(&c, false, false, 32);  // shift left, no autopush
+    sm_config_set_fifo_join(&c, PIO_FIFO_JOIN_RX);
+    sm_config_set_clkdiv(&c, 1.0f);
+
+    pio_sm_init(pio, sm, quadrature_encoder_offset_sample, &c);
+
+    // Seed OSR with the current pin state so the first sample is not
+    // decoded as a transition from 00, and start counting from zero.
+    pio_sm_exec(pio, sm, pio_encode_mov(pio_isr, pio_null));
+    pio_sm_exec(pio, sm, pio_encode_in(pio_pins, 2));
+    pio_sm_exec(pio, sm, pio_encode_mov(pio_osr, pio_isr));
+    pio_sm_exec(pio, sm, pio_encode_set(pio_x, 0));
+
+    pio_sm_set_enabled(pio, sm, true);
+}
+
+// The state machine pushes continuously, so draining the FIFO and waiting
+// for one more value always yields a count no older than a few cycles.
+static inline int32_t quadrature_encoder_get_count(PIO pio, uint sm) {
+    uint n = pio_sm_get_rx_fifo_level(pio, sm) + 1;
+    uint32_t ret = 0;
+    while (n-- > 0) {
+        ret = pio_sm_get_blocking(pio, sm);
+    }
+    return (int32_t)ret;
+}
+
+#endif
@@ -0,0 +1,156 @@
+/**
+ * Host-side model of the quadrature_encoder PIO program
+ *
+ * Executes the exact instruction words from quadrature.pio.h one cycle at a
+ * time, so the decoder can be exercised on Linux without a board. Only the
+ * instruction subset the program uses is modelled (JMP, IN, PUSH, MOV, SET),
+ * with the same register and FIFO semantics as the RP2040 datasheet:
+ * left-shifting ISR, no autopush, and a joined 8-entry RX FIFO where
+ * "push noblock" drops the value when full.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#ifndef PICO_NO_HARDWARE
+#define PICO_NO_HARDWARE 1
+#endif
+#include "quadrature.pio.h"
+
+class QuadraturePioModel {
+public:
+    static const uint8_t RX_FIFO_DEPTH = 8;
+
+    explicit QuadraturePioModel(uint8_t a = 1, uint8_t b = 1) {
+        setPins(a, b);
+        // Mirror quadrature_encoder_program_init(): seed OSR from the pins,
+        // zero X and start at the public "sample" label.
+        osr = pins;
+        x = 0;
+        pc = quadrature_encoder_offset_sample;
+    }
+
+    void setPins(uint8_t a, uint8_t b) { pins = (uint32_t)((b & 1) << 1) | (a & 1); }
+
+    // Run the state machine for the given number of clock cycles
+    void step(uint32_t cycles) {
+        while (cycles-- > 0) {
+            exec(quadrature_encoder_program_instructions[pc]);
+        }
+    }
+
+    // Equivalent of quadrature_encoder_get_count(): drain the FIFO, then run
+    // until one more value is pushed.
+    int32_t getCount() {
+        uint32_t ret = 0;
+        while (fifoLevel > 0) ret = fifoPop();
+        while (fifoLevel == 0) step(1);
+        ret = fifoPop();
+        return (int32_t)ret;
+    }
+
+    int32_t rawX() const { return (int32_t)x; }
+    uint8_t rxLevel() const { return fifoLevel; }
+    uint32_t droppedPushes() const { return dropped; }
+
+private:
+    uint32_t pins = 0;
+    uint32_t x = 0, y = 0, isr = 0, osr = 0;
+    uint8_t pc = 0;
+    uint32_t fifo[RX_FIFO_DEPTH] = {};
+    uint8_t fifoHead = 0, fifoLevel = 0;
+    uint32_t dropped = 0;
+
+    uint32_t fifoPop() {
+        uint32_t v = fifo[fifoHead];
+        fifoHead = (fifoHead + 1) % RX_FIFO_DEPTH;
+        fifoLevel--;
+        return v;
+    }
+
+    void advance() {
+        pc = (pc == quadrature_encoder_wrap) ? quadrature_encoder_wrap_target : pc + 1;
+    }
+
+    uint32_t readSource(uint8_t src) const {
+        switch (src) {
+            case 0: return pins;
+            case 1: return x;
+            case 2: return y;
+            case 6: return isr;
+            case 7: return osr;
+            default: return 0;  // NULL (and STATUS, unused here)
+        }
+    }
+
+    void exec(uint16_t insn) {
+        uint8_t op = insn >> 13;
+        uint8_t arg1 = (insn >> 5) & 0x7;
+        uint8_t arg2 = insn & 0x1F;
+
+        switch (op) {
+            case 0: {  // JMP
+                bool take = true;
+                switch (arg1) {
+                    case 1: take = (x == 0); break;
+                    case 2: take = (x != 0); x--; break;
+                    case 3: take = (y == 0); break;
+                    case 4: take = (y != 0); y--; break;
+                    case 5: take = (x != y); break;
+                    default: break;
+                }
+                if (take) pc = arg2; else advance();
+                return;
+            }
+            case 2: {  // IN (shift left)
+                uint8_t count = arg2 ? arg2 : 32;
+                uint32_t mask = count == 32 ? 0xFFFFFFFFu : ((1u << count) - 1);
+                uint32_t bits = readSource(arg1) & mask;
+                isr = count == 32 ? bits : (isr << count) | bits;
+                break;
+            }
+            case 4: {  // PUSH (PULL is not used)
+                bool block = insn & 0x20;
+                if (fifoLevel < RX_FIFO_DEPTH) {
+                    fifo[(fifoHead + fifoLevel) % RX_FIFO_DEPTH] = isr;
+                    fifoLevel++;
+                } else if (block) {
+                    return;  // stall on this instruction
+                } else {
+                    dropped++;
+                }
+                isr = 0;
+                break;
+            }
+            case 5: {  // MOV
+                uint32_t v = readSource(insn & 0x7);
+                uint8_t mop = (insn >> 3) & 0x3;
+                if (mop == 1) {
+                    v = ~v;
+                } else if (mop == 2) {
+                    uint32_t r = 0;
+                    for (uint8_t i = 0; i < 32; i++) r |= ((v >> i) & 1u) << (31 - i);
+                    v = r;
+                }
+                switch (arg1) {
+                    case 1: x = v; break;
+                    case 2: y = v; break;
+                    case 5: pc = v & 0x1F; return;
+                    case 6: isr = v; break;
+                    case 7: osr = v; break;
+                    default: break;
+                }
+                break;
+            }
+            case 7: {  // SET
+                if (arg1 == 1) x = arg2;
+                else if (arg1 == 2) y = arg2;
+                break;
+            }
+            default:
+                break;
+        }
+        advance();
+    }
+};
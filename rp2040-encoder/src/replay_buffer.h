@@ -0,0 +1,78 @@
+/**
+ * Sequence-numbered event history for lossless delivery
+ *
+ * Every event gets the next sequence number (starting at 1) and stays in
+ * the buffer until N newer ones have pushed it out. A delivery cursor
+ * marks the first event not yet written to the host: events queue behind
+ * it while the host cannot take them (port closed, transmit buffer full)
+ * and go out in order once it can. Rewinding the cursor replays events the
+ * host reports missing, as long as they are still held.
+ *
+ * Single context only (the protocol core). N must be a power of two.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+template <typename T, uint32_t N>
+class ReplayBuffer {
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "ReplayBuffer size must be a power of two");
+
+public:
+    // Store an event; returns its sequence number. An undelivered event
+    // pushed out to make room is lost and counted in dropped().
+    uint32_t append(const T& item) {
+        uint32_t seq = nextSeq++;
+        if (seq - cursor >= N) {
+            cursor++;
+            droppedCount++;
+        }
+        items[seq & (N - 1)] = item;
+        return seq;
+    }
+
+    // Next event to deliver, without consuming it
+    bool peek(uint32_t& seq, T& item) const {
+        if (cursor == nextSeq) return false;
+        seq = cursor;
+        item = items[cursor & (N - 1)];
+        return true;
+    }
+
+    // The event from peek() was written
+    void delivered() {
+        if (cursor != nextSeq) cursor++;
+    }
+
+    // Deliver again from seq. Returns false if it is no longer held (the
+    // host must resynchronise instead) or was never assigned.
+    bool rewind(uint32_t seq) {
+        if (seq < oldest() || seq > nextSeq) return false;
+        if (seq < cursor) {
+            replayedCount += cursor - seq;
+            cursor = seq;
+        }
+        return true;
+    }
+
+    // Drop everything not yet delivered (the host resynchronised past it)
+    void skipPending() {
+        cursor = nextSeq;
+    }
+
+    uint32_t last() const { return nextSeq - 1; }       // 0 = none yet
+    uint32_t lastDelivered() const { return cursor - 1; }
+    uint32_t oldest() const { return nextSeq > N ? nextSeq - N : 1; }
+    uint32_t pending() const { return nextSeq - cursor; }
+    uint32_t dropped() const { return droppedCount; }
+    uint32_t replayed() const { return replayedCount; }
+
+private:
+    T items[N];
+    uint32_t nextSeq = 1;
+    uint32_t cursor = 1;        // First sequence not yet delivered
+    uint32_t droppedCount = 0;
+    uint32_t replayedCount = 0;
+};
@@ -0,0 +1,43 @@
+/**
+ * Single-writer sequence lock for small multi-word snapshots
+ *
+ * The writer bumps the sequence to odd, stores the value and bumps it back
+ * to even; it never waits. Readers copy the value and retry if the sequence
+ * was odd or moved during the copy, so they always see a consistent value
+ * without masking interrupts on either side.
+ *
+ * The writer may be an ISR. A reader on the same core cannot spin forever:
+ * an interrupting writer finishes its store before the reader resumes.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+template <typename T>
+class Seqlock {
+public:
+    // Writer side (one context only)
+    void store(const T& item) {
+        uint32_t seq = __atomic_load_n(&sequence, __ATOMIC_RELAXED);
+        __atomic_store_n(&sequence, seq + 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+        value = item;
+        __atomic_store_n(&sequence, seq + 2, __ATOMIC_RELEASE);
+    }
+
+    // Reader side (any context)
+    T load() const {
+        for (;;) {
+            uint32_t before = __atomic_load_n(&sequence, __ATOMIC_ACQUIRE);
+            if (before & 1) continue;
+            T copy = const_cast<const T&>(value);
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            if (__atomic_load_n(&sequence, __ATOMIC_RELAXED) == before) return copy;
+        }
+    }
+
+private:
+    T value = T();
+    uint32_t sequence = 0;
+};
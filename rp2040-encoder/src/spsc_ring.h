@@ -0,0 +1,68 @@
+/**
+ * Lock-free single-producer / single-consumer ring buffer
+ *
+ * One context pushes, one context pops; neither ever blocks or masks
+ * interrupts. Safe between the two RP2040 cores (SRAM is coherent, the
+ * acquire/release atomics emit the needed DMBs) and between an ISR and the
+ * code it interrupts on the same core.
+ *
+ * N must be a power of two. Indices run freely and wrap at 2^32, so the
+ * full capacity N is usable.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+template <typename T, uint32_t N>
+class SpscRing {
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "SpscRing size must be a power of two");
+
+public:
+    // Producer side. Returns false (and counts an overflow) when full.
+    bool push(const T& item) {
+        uint32_t head = __atomic_load_n(&headIdx, __ATOMIC_RELAXED);
+        uint32_t tail = __atomic_load_n(&tailIdx, __ATOMIC_ACQUIRE);
+        if (head - tail >= N) {
+            __atomic_store_n(&overflowCount, overflowCount + 1, __ATOMIC_RELAXED);
+            return false;
+        }
+        slots[head & (N - 1)] = item;
+        __atomic_store_n(&headIdx, head + 1, __ATOMIC_RELEASE);
+        if (head + 1 - tail > highWaterMark) {
+            __atomic_store_n(&highWaterMark, head + 1 - tail, __ATOMIC_RELAXED);
+        }
+        return true;
+    }
+
+    // Consumer side. Returns false when empty.
+    bool pop(T& item) {
+        uint32_t tail = __atomic_load_n(&tailIdx, __ATOMIC_RELAXED);
+        uint32_t head = __atomic_load_n(&headIdx, __ATOMIC_ACQUIRE);
+        if (head == tail) return false;
+        item = slots[tail & (N - 1)];
+        __atomic_store_n(&tailIdx, tail + 1, __ATOMIC_RELEASE);
+        return true;
+    }
+
+    // Either side; a snapshot that may be stale by the time it is used
+    uint32_t size() const {
+        return __atomic_load_n(&headIdx, __ATOMIC_ACQUIRE) - __atomic_load_n(&tailIdx, __ATOMIC_ACQUIRE);
+    }
+
+    static constexpr uint32_t capacity() { return N; }
+
+    // Pushes rejected because the ring was full (written by the producer only)
+    uint32_t overflows() const { return __atomic_load_n(&overflowCount, __ATOMIC_RELAXED); }
+
+    // Deepest fill level seen at a push (written by the producer only)
+    uint32_t highWater() const { return __atomic_load_n(&highWaterMark, __ATOMIC_RELAXED); }
+
+private:
+    T slots[N];
+    uint32_t headIdx = 0;        // Next slot to write (producer)
+    uint32_t tailIdx = 0;        // Next slot to read (consumer)
+    uint32_t overflowCount = 0;
+    uint32_t highWaterMark = 0;
+};
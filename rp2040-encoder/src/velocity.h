@@ -0,0 +1,81 @@
+/**
+ * Handwheel velocity estimation
+ *
+ * Event-driven alpha-beta filter over click timestamps. update() is fed the
+ * unwrapped click count and the micros() time of the click that produced it;
+ * velocity() returns the filtered rate in clicks per second.
+ *
+ * Between clicks the filter cannot see the wheel slowing down, so
+ * velocity() caps the estimate at one click per elapsed interval (had the
+ * wheel been faster, another click would have arrived) and reports zero
+ * once the wheel has been still for STOP_US.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+class VelocityEstimator {
+public:
+    static constexpr float ALPHA = 0.5f;
+    static constexpr float BETA = 0.15f;
+    static const uint32_t STOP_US = 250000;      // No click for this long = stopped
+    static const uint32_t MIN_DT_US = 50;        // Clicks batched in one sample
+
+    void reset() {
+        primed = false;
+        x = 0.0f;
+        v = 0.0f;
+    }
+
+    void update(int32_t clicks, uint32_t tMicros) {
+        if (!primed || (uint32_t)(tMicros - lastMicros) >= STOP_US) {
+            // Starting from rest: nothing to extrapolate from yet
+            primed = true;
+            x = (float)clicks;
+            v = 0.0f;
+            lastClicks = clicks;
+            lastMicros = tMicros;
+            return;
+        }
+
+        uint32_t dtUs = tMicros - lastMicros;
+        if (dtUs < MIN_DT_US) dtUs = MIN_DT_US;
+        float dt = (float)dtUs * 1e-6f;
+
+        // A reversal invalidates the old rate entirely
+        int32_t step = clicks - lastClicks;
+        if ((step > 0 && v < 0.0f) || (step < 0 && v > 0.0f)) {
+            v = 0.0f;
+            x = (float)lastClicks;
+        }
+
+        float predicted = x + v * dt;
+        float residual = (float)clicks - predicted;
+        x = predicted + ALPHA * residual;
+        v += (BETA / dt) * residual;
+
+        lastClicks = clicks;
+        lastMicros = tMicros;
+    }
+
+    // Filtered velocity in clicks/s at time nowMicros
+    float velocity(uint32_t nowMicros) const {
+        if (!primed) return 0.0f;
+        uint32_t idleUs = nowMicros - lastMicros;
+        if (idleUs >= STOP_US) return 0.0f;
+        if (idleUs > 0) {
+            float bound = 1e6f / (float)idleUs;
+            if (v > bound) return bound;
+            if (v < -bound) return -bound;
+        }
+        return v;
+    }
+
+private:
+    bool primed = false;
+    float x = 0.0f;              // Filtered position (clicks)
+    float v = 0.0f;              // Filtered velocity (clicks/s)
+    int32_t lastClicks = 0;
+    uint32_t lastMicros = 0;
+};
@@ -0,0 +1,363 @@
+/**
+ * Host side of the firmware's link benchmark ({"type":"bench"})
+ *
+ * Drives the encoder over a serial port (/dev/ttyACM0) or over the pty
+ * printed by the native firmware build (pio run -e native_pty -t exec):
+ *
+ *   link_bench PORT echo  [--count N] [--size BYTES] [--binary]
+ *       N echo round trips, one at a time. Prints round-trip percentiles
+ *       and the device's own turnaround (rx -> tx).
+ *
+ *   link_bench PORT flood [--rate HZ] [--size BYTES] [--count N] [--binary]
+ *       The device emits N frames at HZ. Prints what arrived (frames, seq
+ *       gaps, bytes, achieved rate) next to the device summary (sent,
+ *       dropped on a full transmit buffer, skipped when its loop fell
+ *       behind, worst due -> written delay).
+ *
+ * --size is bytes per frame on the wire; the default is an encoder event
+ * (110 JSON, 33 binary). --binary switches the firmware to the binary
+ * protocol for the run.
+ *
+ * Build:  g++ -std=gnu++17 -O2 -o link_bench tools/link_bench.cpp
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <unistd.h>
+#include <vector>
+
+#include "../src/binary_protocol.h"
+
+namespace {
+    typedef std::chrono::steady_clock Clock;
+
+    const size_t JSON_EVENT_SIZE = 110;
+    const size_t BINARY_EVENT_SIZE = 33;
+
+    struct Options {
+        const char* port = nullptr;
+        const char* mode = nullptr;
+        long count = 1000;
+        long rate = 1000;
+        long size = -1;
+        bool binary = false;
+    };
+
+    // One message from the device: a JSON line, or a decoded binary record
+    struct Message {
+        std::string json;               // JSON line or text record; empty for REC_BENCH
+        bool bench = false;
+        uint8_t kind = 0;
+        uint32_t seq = 0;
+        uint32_t rx = 0;
+        uint32_t tx = 0;
+        size_t wireBytes = 0;
+    };
+
+    bool hasToken(const std::string& json, const char* token) {
+        return json.find(token) != std::string::npos;
+    }
+
+    // Integer value of "key" in a flat JSON object, 0 if missing
+    long long jsonNumber(const std::string& json, const char* key) {
+        std::string token = std::string("\"") + key + "\":";
+        size_t pos = json.find(token);
+        return pos == std::string::npos ? 0 : strtoll(json.c_str() + pos + token.size(), nullptr, 10);
+    }
+
+    class Link {
+    public:
+        bool open(const char* path) {
+            fd = ::open(path, O_RDWR | O_NOCTTY | O_NONBLOCK);
+            if (fd < 0) return false;
+            termios tio;
+            if (tcgetattr(fd, &tio) == 0) {
+                cfmakeraw(&tio);
+                cfsetspeed(&tio, B115200);
+                tcsetattr(fd, TCSANOW, &tio);
+            }
+            // The firmware only writes while DTR is up (not applicable to a pty)
+            int bits = TIOCM_DTR | TIOCM_RTS;
+            ioctl(fd, TIOCMBIS, &bits);
+            tcflush(fd, TCIFLUSH);
+            return true;
+        }
+
+        void send(const std::string& line) {
+            std::string data = line + "\n";
+            size_t off = 0;
+            while (off < data.size()) {
+                ssize_t n = ::write(fd, data.data() + off, data.size() - off);
+                if (n > 0) {
+                    off += (size_t)n;
+                } else if (n < 0 && errno != EAGAIN && errno != EINTR) {
+                    perror("write");
+                    exit(1);
+                } else {
+                    pollfd p = {fd, POLLOUT, 0};
+                    poll(&p, 1, 100);
+                }
+            }
+        }
+
+        // Next message within timeoutMs; false on timeout
+        bool next(Message& msg, int timeoutMs) {
+            auto deadline = Clock::now() + std::chrono::milliseconds(timeoutMs);
+            for (;;) {
+                if (extract(msg)) return true;
+                int left = (int)std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now()).count();
+                if (left <= 0) return false;
+                pollfd p = {fd, POLLIN, 0};
+                if (poll(&p, 1, left) <= 0) continue;
+                char buf[4096];
+                ssize_t n = ::read(fd, buf, sizeof(buf));
+                if (n > 0) {
+                    bytesIn += (size_t)n;
+                    in.append(buf, (size_t)n);
+                }
+            }
+        }
+
+        bool binary = false;
+        size_t bytesIn = 0;
+        unsigned long badFrames = 0;
+
+    private:
+        bool extract(Message& msg) {
+            for (;;) {
+                size_t end = in.find(binary ? '\0' : '\n');
+                if (end == std::string::npos) return false;
+                std::string raw = in.substr(0, end);
+                in.erase(0, end + 1);
+                msg = Message();
+                msg.wireBytes = end + 1;
+                if (!binary) {
+                    while (!raw.empty() && (raw.back() == '\r' || raw.back() == ' ')) raw.pop_back();
+                    if (raw.empty()) continue;
+                    msg.json = raw;
+                    if (hasToken(raw, "\"type\":\"bench_echo\"") || hasToken(raw, "\"type\":\"bench_flood\"")) {
+                        msg.bench = true;
+                        msg.kind = hasToken(raw, "\"type\":\"bench_echo\"") ? 1 : 2;
+                        msg.seq = (uint32_t)jsonNumber(raw, "seq");
+                        msg.rx = (uint32_t)jsonNumber(raw, msg.kind == 1 ? "rx" : "due");
+                        msg.tx = (uint32_t)jsonNumber(raw, "tx");
+                    }
+                    return true;
+                }
+                if (raw.empty()) continue;
+                if (!decodeFrame(raw, msg)) {
+                    badFrames++;
+                    continue;
+                }
+                return true;
+            }
+        }
+
+        bool decodeFrame(const std::string& frame, Message& msg) {
+            uint8_t record[MAX_RECORD_SIZE + 8];
+            size_t out = 0;
+            size_t i = 0;
+            while (i < frame.size()) {
+                uint8_t code = (uint8_t)frame[i++];
+                if (code == 0 || i + code - 1 > frame.size() || out + code > sizeof(record)) return false;
+                for (uint8_t k = 1; k < code; k++) record[out++] = (uint8_t)frame[i++];
+                if (code != 0xFF && i < frame.size()) record[out++] = 0;
+            }
+            if (out < 3) return false;
+            size_t len = out - 2;
+            uint16_t crc = (uint16_t)(record[len] | (record[len + 1] << 8));
+            if (crc16Ccitt(record, len) != crc) return false;
+
+            if (record[0] == REC_TEXT) {
+                msg.json.assign((const char*)record + 1, len - 1);
+            } else if (record[0] == REC_BENCH && len >= REC_BENCH_SIZE) {
+                msg.bench = true;
+                msg.kind = record[1];
+                msg.seq = le32(record + 2);
+                msg.rx = le32(record + 6);
+                msg.tx = le32(record + 10);
+            }
+            return true;
+        }
+
+        static uint32_t le32(const uint8_t* p) {
+            return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+        }
+
+        int fd = -1;
+        std::string in;
+    };
+
+    double percentile(std::vector<double>& values, double q) {
+        if (values.empty()) return 0;
+        std::sort(values.begin(), values.end());
+        size_t i = std::min(values.size() - 1, (size_t)(q * (double)values.size()));
+        return values[i];
+    }
+
+    void printStats(const char* name, std::vector<double>& values) {
+        if (values.empty()) {
+            printf("%-22s no samples\n", name);
+            return;
+        }
+        double p50 = percentile(values, 0.50);
+        double p90 = percentile(values, 0.90);
+        double p99 = percentile(values, 0.99);
+        printf("%-22s min %8.0f  p50 %8.0f  p90 %8.0f  p99 %8.0f  max %8.0f us\n",
+               name, values.front(), p50, p90, p99, values.back());
+    }
+
+    // Switch the output protocol and wait for the acknowledgement, which
+    // arrives in the old format
+    void setProtocol(Link& link, bool binary) {
+        link.send(binary ? "{\"type\":\"protocol\",\"mode\":\"binary\"}" : "{\"type\":\"protocol\",\"mode\":\"json\"}");
+        Message msg;
+        while (link.next(msg, 1000)) {
+            if (hasToken(msg.json, "\"type\":\"protocol\"")) {
+                link.binary = binary;
+                return;
+            }
+        }
+        fprintf(stderr, "No protocol acknowledgement; is the firmware running?\n");
+        exit(1);
+    }
+
+    int runEcho(Link& link, const Options& opt) {
+        std::vector<double> rtt, device;
+        long lost = 0;
+        char cmd[128];
+        for (long i = 0; i < opt.count; i++) {
+            snprintf(cmd, sizeof(cmd), "{\"type\":\"bench\",\"mode\":\"echo\",\"seq\":%ld,\"size\":%ld}", i, opt.size);
+            auto sent = Clock::now();
+            link.send(cmd);
+            Message msg;
+            bool got = false;
+            while (link.next(msg, 1000)) {
+                if (msg.bench && msg.kind == 1 && msg.seq == (uint32_t)i) {
+                    got = true;
+                    break;
+                }
+            }
+            if (!got) {
+                lost++;
+                continue;
+            }
+            rtt.push_back(std::chrono::duration<double, std::micro>(Clock::now() - sent).count());
+            device.push_back((double)(int32_t)(msg.tx - msg.rx));
+        }
+        printf("echo: %ld sent, %ld lost, %ld bytes/frame\n", opt.count, lost, opt.size);
+        printStats("round trip", rtt);
+        printStats("device rx -> tx", device);
+        return lost == 0 ? 0 : 2;
+    }
+
+    int runFlood(Link& link, const Options& opt) {
+        char cmd[160];
+        snprintf(cmd, sizeof(cmd), "{\"type\":\"bench\",\"mode\":\"flood\",\"rate\":%ld,\"size\":%ld,\"count\":%ld}",
+                 opt.rate, opt.size, opt.count);
+        link.send(cmd);
+
+        long received = 0, gaps = 0, missing = 0;
+        long long lastSeq = -1;
+        size_t bytes = 0;
+        std::vector<double> lateness;
+        Clock::time_point first, last;
+        std::string summary;
+        int timeoutMs = (int)(opt.count * 1000 / std::max(1L, opt.rate)) + 2000;
+        Message msg;
+        while (link.next(msg, timeoutMs)) {
+            if (msg.bench && msg.kind == 2) {
+                if (received == 0) first = Clock::now();
+                last = Clock::now();
+                received++;
+                bytes += msg.wireBytes;
+                if ((long long)msg.seq != lastSeq + 1) {
+                    gaps++;
+                    missing += (long)((long long)msg.seq - lastSeq - 1);
+                }
+                lastSeq = msg.seq;
+                lateness.push_back((double)(int32_t)(msg.tx - msg.rx));
+                continue;
+            }
+            if (hasToken(msg.json, "\"type\":\"bench_summary\"")) {
+                summary = msg.json;
+                break;
+            }
+        }
+
+        double seconds = received > 1 ? std::chrono::duration<double>(last - first).count() : 0;
+        printf("flood: %ld Hz x %ld frames, %ld bytes/frame requested\n", opt.rate, opt.count, opt.size);
+        printf("host:   %ld received, %ld gaps (%ld frames missing), %zu bytes", received, gaps, missing, bytes);
+        if (seconds > 0) {
+            printf(", %.0f frames/s, %.1f kB/s", (double)(received - 1) / seconds, (double)bytes / seconds / 1000.0);
+        }
+        if (link.badFrames > 0) printf(", %lu bad frames", link.badFrames);
+        printf("\n");
+        printStats("device due -> tx", lateness);
+        if (summary.empty()) {
+            printf("device: no summary (timed out)\n");
+            return 2;
+        }
+        printf("device: %lld sent, %lld dropped (buffer full), %lld late (loop behind), "
+               "%lld frames/s, %.1f kB/s, max late %lld us\n",
+               jsonNumber(summary, "sent"), jsonNumber(summary, "dropped"), jsonNumber(summary, "late"),
+               jsonNumber(summary, "achievedRate"), (double)jsonNumber(summary, "bytesPerSec") / 1000.0,
+               jsonNumber(summary, "maxLateUs"));
+        return 0;
+    }
+
+    void usage() {
+        fprintf(stderr,
+                "usage: link_bench PORT echo  [--count N] [--size BYTES] [--binary]\n"
+                "       link_bench PORT flood [--rate HZ] [--size BYTES] [--count N] [--binary]\n");
+        exit(1);
+    }
+}
+
+int main(int argc, char** argv) {
+    Options opt;
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (strcmp(arg, "--count") == 0 && hasValue) opt.count = strtol(argv[++i], nullptr, 10);
+        else if (strcmp(arg, "--rate") == 0 && hasValue) opt.rate = strtol(argv[++i], nullptr, 10);
+        else if (strcmp(arg, "--size") == 0 && hasValue) opt.size = strtol(argv[++i], nullptr, 10);
+        else if (strcmp(arg, "--binary") == 0) opt.binary = true;
+        else if (arg[0] == '-') usage();
+        else if (!opt.port) opt.port = arg;
+        else if (!opt.mode) opt.mode = arg;
+        else usage();
+    }
+    if (!opt.port || !opt.mode || opt.count <= 0 || opt.rate <= 0) usage();
+    if (opt.size < 0) opt.size = (long)(opt.binary ? BINARY_EVENT_SIZE : JSON_EVENT_SIZE);
+
+    Link link;
+    if (!link.open(opt.port)) {
+        perror(opt.port);
+        return 1;
+    }
+    setProtocol(link, opt.binary);
+
+    int result;
+    if (strcmp(opt.mode, "echo") == 0) {
+        result = runEcho(link, opt);
+    } else if (strcmp(opt.mode, "flood") == 0) {
+        result = runFlood(link, opt);
+    } else {
+        usage();
+        return 1;
+    }
+
+    if (opt.binary) setProtocol(link, false);
+    return result;
+}